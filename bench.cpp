@@ -0,0 +1,350 @@
+#include "stix.hpp"
+#include "threadpool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Position {
+    const char* name;
+    stix::Player a;
+    stix::Player b;
+    stix::PlayerID to_move;
+    bool decided; // Searched until proven instead of to a fixed depth
+};
+
+// Fixed suite, the decided positions are the longest wins and losses of the game
+const Position positions[] = {
+    {"start", {1, 1}, {1, 1}, stix::PLAYER_A, false},
+    {"balanced", {2, 2}, {3, 3}, stix::PLAYER_A, false},
+    {"win-25", {0, 2}, {1, 1}, stix::PLAYER_B, true},
+    {"loss-24", {0, 3}, {1, 1}, stix::PLAYER_A, true},
+    {"win-19", {0, 4}, {3, 4}, stix::PLAYER_B, true},
+    {"win-9", {0, 4}, {2, 3}, stix::PLAYER_B, true},
+};
+
+struct Result {
+    std::string benchmark;
+    std::string position;
+    std::string mode;
+    unsigned int threads;
+    unsigned int depth;
+    double seconds;
+    uint64_t count; // Nodes searched, or tasks run by the thread pool benchmarks
+    double speedup;
+
+    inline double rate() const {
+        return seconds > 0. ? count / seconds : 0.;
+    }
+};
+
+struct Options {
+    std::string format = "table";
+    unsigned int depth = 1000;
+    uint64_t nodes = 50000000; // Per time-to-depth search, so a slow search still ends at the depth reaching it, 0 disables
+    unsigned int kernel_depth = 16;
+    unsigned int mcts_depth = 16; // 2^N playouts per Monte Carlo search
+    unsigned int max_threads = std::thread::hardware_concurrency();
+    unsigned int repeat = 3;
+    double budget = 10.;
+    unsigned int tasks = 100000;
+    bool symmetry_reduction = false;
+    std::vector<tp::CpuSet> affinity; // Of every pool the benchmarks create
+};
+
+stix::Game make_game(const Position& position) {
+    stix::Game game(position.to_move);
+    game.game_state[stix::PLAYER_A] = position.a;
+    game.game_state[stix::PLAYER_B] = position.b;
+    return game;
+}
+
+const char* mode_name(stix::SearchMode mode) {
+    switch (mode) {
+        case stix::SearchMode::RootSplit:
+            return "root-split";
+        case stix::SearchMode::LazySMP:
+            return "lazy-smp";
+        case stix::SearchMode::MCTS:
+            return "mcts";
+        default:
+            return "proof-number";
+    }
+}
+
+const char* policy_name(stix::PlayoutPolicy policy) {
+    return policy == stix::PlayoutPolicy::Random ? "random" : (policy == stix::PlayoutPolicy::Decisive ? "decisive" : "anti-decisive");
+}
+
+// Runs func repeat times and keeps the fastest run, func returns the seconds and count of one run
+template <typename F>
+std::pair<double, uint64_t> best_of(unsigned int repeat, F func) {
+    std::pair<double, uint64_t> ret = func();
+    for (unsigned int i = 1; i < repeat; i++) {
+        std::pair<double, uint64_t> run = func();
+        if (run.first < ret.first) {
+            ret = run;
+        }
+    }
+    return ret;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Raw alpha-beta speed of the search kernels, single threaded and without a transposition table
+void bench_kernel(const Options& options, std::vector<Result>& results) {
+    for (const Position& position : positions) {
+        if (position.decided) {
+            continue;
+        }
+
+        stix::Game game = make_game(position);
+        stix::StateIndex root = stix::pack_state(game.game_state);
+        const stix::Successors& successors = stix::move_table.successors[root][position.to_move];
+
+        auto [seconds, nodes] = best_of(options.repeat, [&]() {
+            std::atomic<bool> stop(false);
+            stix::SearchContext ctx(stop, position.to_move);
+            ctx.push(stix::position_key(root, position.to_move));
+
+            auto start = std::chrono::steady_clock::now();
+            for (uint8_t i = 0; i < successors.size; i++) {
+                game.mini(successors.children[i], -stix::score_infinity, stix::score_infinity, options.kernel_depth - 1, ctx);
+            }
+            return std::make_pair(seconds_since(start), ctx.stats.nodes);
+        });
+        results.push_back({"kernel", position.name, "serial", 1, options.kernel_depth, seconds, nodes, 1.});
+    }
+}
+
+// Time to complete every depth up to options.depth, or up to the depth that reaches options.nodes, and time for
+// find_best_move to prove decided positions. The proof-number search has no depth of its own and only takes part in
+// proving
+void bench_search(const Options& options, const std::vector<unsigned int>& thread_counts, std::vector<Result>& results) {
+    for (const Position& position : positions) {
+        for (stix::SearchMode mode : {stix::SearchMode::RootSplit, stix::SearchMode::LazySMP, stix::SearchMode::ProofNumber}) {
+            if (mode == stix::SearchMode::ProofNumber && !position.decided) {
+                continue;
+            }
+
+            double baseline = 0.;
+            for (unsigned int threads : thread_counts) {
+                tp::ThreadPool pool(threads, tp::SchedulingPolicy::WorkStealing, options.affinity);
+
+                unsigned int depth = 0;
+                auto [seconds, nodes] = best_of(options.repeat, [&]() {
+                    stix::TranspositionTable tt;
+                    stix::SearchStats stats;
+                    stix::Game game = make_game(position);
+                    game.tt = &tt;
+                    game.stats = &stats;
+                    game.search_mode = mode;
+                    game.symmetry_reduction = options.symmetry_reduction;
+                    game.pool = &pool;
+                    game.node_budget = options.nodes;
+
+                    auto start = std::chrono::steady_clock::now();
+                    if (position.decided) {
+                        depth = game.find_best_move(std::chrono::duration<double>(options.budget), 1).depth;
+                    } else {
+                        depth = game.find_best_move_to_depth(options.depth).depth;
+                    }
+                    return std::make_pair(seconds_since(start), stats.nodes);
+                });
+
+                if (threads == 1) {
+                    baseline = seconds;
+                }
+                results.push_back({position.decided ? "time-to-solve" : "time-to-depth", position.name, mode_name(mode), threads, depth, seconds, nodes, baseline / seconds});
+            }
+        }
+    }
+}
+
+// Playout throughput of the Monte Carlo search under every playout policy, the count is playouts
+void bench_mcts(const Options& options, const std::vector<unsigned int>& thread_counts, std::vector<Result>& results) {
+    for (const Position& position : positions) {
+        if (position.decided) {
+            continue;
+        }
+
+        for (stix::PlayoutPolicy policy : {stix::PlayoutPolicy::Random, stix::PlayoutPolicy::Decisive, stix::PlayoutPolicy::AntiDecisive}) {
+            double baseline = 0.;
+            for (unsigned int threads : thread_counts) {
+                tp::ThreadPool pool(threads, tp::SchedulingPolicy::WorkStealing, options.affinity);
+
+                auto [seconds, playouts] = best_of(options.repeat, [&]() {
+                    stix::SearchStats stats;
+                    stix::Game game = make_game(position);
+                    game.stats = &stats;
+                    game.search_mode = stix::SearchMode::MCTS;
+                    game.mcts.playout_policy = policy;
+                    game.symmetry_reduction = options.symmetry_reduction;
+                    game.pool = &pool;
+
+                    auto start = std::chrono::steady_clock::now();
+                    game.find_best_move_to_depth(options.mcts_depth);
+                    return std::make_pair(seconds_since(start), stats.leaves);
+                });
+
+                if (threads == 1) {
+                    baseline = seconds;
+                }
+                results.push_back({"mcts", position.name, policy_name(policy), threads, options.mcts_depth, seconds, playouts, baseline / seconds});
+            }
+        }
+    }
+}
+
+// Empty task throughput of both scheduling interfaces under both policies
+void bench_pool(const Options& options, const std::vector<unsigned int>& thread_counts, std::vector<Result>& results) {
+    for (tp::SchedulingPolicy policy : {tp::SchedulingPolicy::RoundRobin, tp::SchedulingPolicy::WorkStealing}) {
+        const char* policy_name = policy == tp::SchedulingPolicy::RoundRobin ? "round-robin" : "work-stealing";
+
+        double schedule_baseline = 0.;
+        double group_baseline = 0.;
+        for (unsigned int threads : thread_counts) {
+            tp::ThreadPool pool(threads, policy, options.affinity);
+
+            auto [schedule_seconds, scheduled] = best_of(options.repeat, [&]() {
+                std::vector<std::shared_ptr<tp::Task>> tasks;
+                tasks.reserve(options.tasks);
+
+                auto start = std::chrono::steady_clock::now();
+                for (unsigned int i = 0; i < options.tasks; i++) {
+                    tasks.push_back(pool.schedule([](void*) {}));
+                }
+                for (auto& task : tasks) {
+                    task->await();
+                }
+                return std::make_pair(seconds_since(start), (uint64_t) options.tasks);
+            });
+
+            auto [group_seconds, grouped] = best_of(options.repeat, [&]() {
+                tp::TaskGroup group(pool);
+
+                auto start = std::chrono::steady_clock::now();
+                for (unsigned int i = 0; i < options.tasks; i++) {
+                    group.run([]() {});
+                }
+                group.wait();
+                return std::make_pair(seconds_since(start), (uint64_t) options.tasks);
+            });
+
+            if (threads == 1) {
+                schedule_baseline = schedule_seconds;
+                group_baseline = group_seconds;
+            }
+            results.push_back({"pool-schedule", "", policy_name, threads, 0, schedule_seconds, scheduled, schedule_baseline / schedule_seconds});
+            results.push_back({"pool-group", "", policy_name, threads, 0, group_seconds, grouped, group_baseline / group_seconds});
+        }
+    }
+}
+
+void print_table(const std::vector<Result>& results) {
+    std::cout << std::left << std::setw(15) << "Benchmark" << std::setw(10) << "Position" << std::setw(15) << "Mode"
+              << std::setw(9) << "Threads" << std::setw(7) << "Depth" << std::setw(13) << "Seconds" << std::setw(13) << "Count"
+              << std::setw(13) << "Rate" << "Speedup" << std::endl;
+    for (const Result& result : results) {
+        std::cout << std::setw(15) << result.benchmark << std::setw(10) << result.position << std::setw(15) << result.mode
+                  << std::setw(9) << result.threads << std::setw(7) << result.depth << std::setw(13) << result.seconds << std::setw(13) << result.count
+                  << std::setw(13) << result.rate() << result.speedup << std::endl;
+    }
+}
+
+void print_csv(const std::vector<Result>& results) {
+    std::cout << "benchmark,position,mode,threads,depth,seconds,count,rate,speedup" << std::endl;
+    for (const Result& result : results) {
+        std::cout << result.benchmark << ',' << result.position << ',' << result.mode << ',' << result.threads << ',' << result.depth << ','
+                  << result.seconds << ',' << result.count << ',' << result.rate() << ',' << result.speedup << std::endl;
+    }
+}
+
+void print_json(const std::vector<Result>& results) {
+    std::cout << '[' << std::endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        std::cout << "  {\"benchmark\": \"" << result.benchmark << "\", \"position\": \"" << result.position << "\", \"mode\": \"" << result.mode
+                  << "\", \"threads\": " << result.threads << ", \"depth\": " << result.depth << ", \"seconds\": " << result.seconds
+                  << ", \"count\": " << result.count << ", \"rate\": " << result.rate() << ", \"speedup\": " << result.speedup << '}'
+                  << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    std::cout << ']' << std::endl;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    std::vector<std::string> benchmarks;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc) {
+            options.format = argv[++i];
+        } else if (arg == "--depth" && i + 1 < argc) {
+            options.depth = std::stoul(argv[++i]);
+        } else if (arg == "--nodes" && i + 1 < argc) {
+            options.nodes = std::stoull(argv[++i]);
+        } else if (arg == "--kernel-depth" && i + 1 < argc) {
+            options.kernel_depth = std::stoul(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.max_threads = std::stoul(argv[++i]);
+        } else if (arg == "--mcts-depth" && i + 1 < argc) {
+            options.mcts_depth = std::stoul(argv[++i]);
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            options.repeat = std::stoul(argv[++i]);
+        } else if (arg == "--budget" && i + 1 < argc) {
+            options.budget = std::stod(argv[++i]);
+        } else if (arg == "--tasks" && i + 1 < argc) {
+            options.tasks = std::stoul(argv[++i]);
+        } else if (arg == "--symmetry") {
+            options.symmetry_reduction = true;
+        } else if (arg == "--affinity" && i + 1 < argc && (std::string(argv[i + 1]) == "cpu" || std::string(argv[i + 1]) == "numa")) {
+            options.affinity = std::string(argv[++i]) == "cpu" ? tp::cpu_affinity() : tp::numa_affinity();
+        } else if (arg == "kernel" || arg == "search" || arg == "mcts" || arg == "pool") {
+            benchmarks.push_back(arg);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [kernel] [search] [mcts] [pool] [--format table|csv|json] [--depth N] [--nodes N] [--kernel-depth N]"
+                      << " [--mcts-depth N] [--threads N] [--repeat N] [--budget SECONDS] [--tasks N] [--symmetry] [--affinity cpu|numa]" << std::endl;
+            return 1;
+        }
+    }
+    if (benchmarks.empty()) {
+        benchmarks = {"kernel", "search", "mcts", "pool"};
+    }
+    options.max_threads = std::max(options.max_threads, 1u);
+    options.kernel_depth = std::max(options.kernel_depth, 1u);
+    options.repeat = std::max(options.repeat, 1u);
+
+    std::vector<unsigned int> thread_counts;
+    for (unsigned int i = 1; i < options.max_threads; i *= 2) {
+        thread_counts.push_back(i);
+    }
+    thread_counts.push_back(options.max_threads);
+
+    std::vector<Result> results;
+    for (const std::string& benchmark : benchmarks) {
+        if (benchmark == "kernel") {
+            bench_kernel(options, results);
+        } else if (benchmark == "search") {
+            bench_search(options, thread_counts, results);
+        } else if (benchmark == "mcts") {
+            bench_mcts(options, thread_counts, results);
+        } else {
+            bench_pool(options, thread_counts, results);
+        }
+    }
+
+    if (options.format == "csv") {
+        print_csv(results);
+    } else if (options.format == "json") {
+        print_json(results);
+    } else {
+        print_table(results);
+    }
+
+    return 0;
+}
@@ -1,6 +1,12 @@
 #include "stix.hpp"
 #include <chrono>
+#include <condition_variable>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
 
 void print_game(const stix::Game& game) {
     std::cout << "          L" << ' ' << 'R' << std::endl;
@@ -8,8 +14,310 @@ void print_game(const stix::Game& game) {
     std::cout << "Player:   " << +game.game_state[stix::PLAYER_A][stix::HAND_L] << ' ' << +game.game_state[stix::PLAYER_A][stix::HAND_R] << std::endl;
 }
 
-int main() {
+// Reads "AL AR BL BR a|b [depth N] [nodes N]" lines and writes one result line per position as soon as it is ready,
+// prefixed with its input line number
+int batch(int argc, char** argv) {
+    unsigned int depth = 64;
+    uint64_t nodes = 0;
+    bool use_tablebase = false;
+    bool share_table = false;
+    std::ifstream file;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--depth" && i + 1 < argc) {
+            depth = std::stoul(argv[++i]);
+        } else if (arg == "--nodes" && i + 1 < argc) {
+            nodes = std::stoull(argv[++i]);
+        } else if (arg == "--tablebase") {
+            use_tablebase = true;
+        } else if (arg == "--shared-table") {
+            share_table = true;
+        } else if (arg[0] != '-' && !file.is_open()) {
+            file.open(arg);
+            if (!file) {
+                std::cerr << "Cannot open " << arg << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Usage: " << argv[0] << " --batch [--depth N] [--nodes N] [--tablebase] [--shared-table] [file]" << std::endl;
+            return 1;
+        }
+    }
+    std::istream& input = file.is_open() ? file : std::cin;
+
+    size_t line_number = 0;
+    auto next = [&](stix::AnalysisJob& job) {
+        std::string line;
+        while (std::getline(input, line)) {
+            line_number++;
+            std::istringstream fields(line);
+            int first;
+            if (!(std::istringstream(line) >> first)) {
+                continue; // Blank or comment line
+            } else if (!stix::parse_position(fields, job.players, job.to_move)) {
+                std::cerr << "Line " << line_number << ": expected AL AR BL BR a|b" << std::endl;
+                continue;
+            }
+
+            job.id = line_number;
+            job.depth = depth;
+            job.nodes = nodes;
+
+            std::string key;
+            uint64_t value;
+            while (fields >> key >> value) {
+                if (key == "depth") {
+                    job.depth = value;
+                } else if (key == "nodes") {
+                    job.nodes = value;
+                }
+            }
+            return true;
+        }
+        return false;
+    };
+
+    auto emit = [](const stix::AnalysisResult& result) {
+        const stix::BestMove& best_move = result.best_move;
+        std::cout << result.id << " move " << stix::move_string(best_move) << " score " << best_move.score << " depth " << best_move.depth << " nodes " << result.nodes;
+        if (best_move.solved) {
+            std::cout << " solved " << (best_move.outcome == stix::OUTCOME_WIN ? "win" : best_move.outcome == stix::OUTCOME_LOSS ? "loss" : "draw");
+        }
+        std::cout << std::endl;
+    };
+
+    stix::TranspositionTable tt;
+    stix::analyze(next, emit, use_tablebase ? &stix::Tablebase::standard() : nullptr, share_table ? &tt : nullptr);
+    return 0;
+}
+
+// What one go has found so far, shared with the search threads that report on it
+struct EngineSearch {
+    std::shared_ptr<stix::SearchJob> job;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    stix::BestMove best_move;
+    bool found = false;
+    bool reported = false; // An info line went out, which tablebase answers skip
+
+    // A search go replaced while it was still running, whose bestmove has to go out before anything of this one
+    std::shared_ptr<EngineSearch> previous;
+
+    // Raised once bestmove went out, after the job itself reports being done
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool finished = false;
+
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+        }
+        condition.notify_all();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this]() { return finished; });
+    }
+
+    // Holds back the first report of this search until the previous one is done, which it already was asked to be
+    void follow() {
+        if (previous) {
+            previous->wait();
+            previous.reset();
+        }
+    }
+};
+
+// Line protocol for programs driving the engine, similar to UCI. Commands are read while searches run:
+//   position startpos|AL AR BL BR a|b [moves MOVE...] MOVE is attack L R or split L R N
+//   go [depth N] [movetime MS] [nodes N]              -> info depth D score S nodes N nps N time MS pv MOVE... after every
+//                                                        depth, then bestmove MOVE [solved win|loss|draw]
+//   stop                                              -> the search ends with its bestmove
+//   isready                                           -> readyok
+//   newgame                                           forgets the transposition table
+//   quit
+// Anything else gets "error ..." back. The tablebase and table stay warm from one game to the next
+int engine(int argc, char** argv) {
+    stix::Game game(stix::PLAYER_A);
+    game.tablebase = &stix::Tablebase::standard();
+    for (int i = 2; i < argc; i++) {
+        if (std::string(argv[i]) == "--no-tablebase") {
+            game.tablebase = nullptr;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " --engine [--no-tablebase]" << std::endl;
+            return 1;
+        }
+    }
+    stix::TranspositionTable tt;
+    game.tt = &tt;
+
+    // Lines come from the search threads as well as this one
+    std::mutex output_mutex;
+    auto say = [&output_mutex](const std::string& line) {
+        std::lock_guard<std::mutex> lock(output_mutex);
+        std::cout << line << std::endl;
+    };
+
+    auto info = [&say](stix::Game& searcher, const stix::BestMove& best_move, const stix::SearchStats& stats, double seconds) {
+        std::ostringstream ret;
+        ret << "info depth " << best_move.depth << " score " << best_move.score << " nodes " << stats.nodes << " nps "
+            << (uint64_t) (seconds > 0. ? stats.nodes / seconds : 0.) << " time " << (uint64_t) (seconds * 1000.) << " pv " << stix::move_string(best_move);
+        stix::GameState game_state = {searcher.game_state[stix::PLAYER_A], searcher.game_state[stix::PLAYER_B]};
+        stix::apply_move(game_state, best_move);
+        for (const stix::Move& move : searcher.principal_variation(stix::pack_state(game_state), (stix::PlayerID) !searcher.player_id, std::max(best_move.depth, 1u) - 1)) {
+            ret << ' ' << stix::move_string(move);
+        }
+        say(ret.str());
+    };
+
+    // Like a deadline, stopping lets the first depth complete so there is always a move to report. The search thread
+    // sends bestmove once it has stopped, so reading goes on at once
+    std::shared_ptr<EngineSearch> search;
+    auto stop = [&search]() {
+        if (search) {
+            search->job->request_stop();
+        }
+    };
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream fields(line);
+        std::string command;
+        if (!(fields >> command)) {
+            continue;
+        }
+
+        if (command == "quit") {
+            break;
+        } else if (command == "isready") {
+            say("readyok");
+        } else if (command == "stop") {
+            stop();
+        } else if (command == "newgame") {
+            stop();
+            tt.clear();
+        } else if (command == "position") {
+            stop();
+            stix::Game position = game;
+            std::string start;
+            if (fields >> std::ws && fields.peek() == 's' && fields >> start && start == "startpos") {
+                position.game_state[stix::PLAYER_A] = {1, 1};
+                position.game_state[stix::PLAYER_B] = {1, 1};
+                position.player_id = stix::PLAYER_A;
+            } else if (!start.empty() || !stix::parse_position(fields, position.game_state, position.player_id)) {
+                say("error expected position startpos|AL AR BL BR a|b [moves MOVE...]");
+                continue;
+            }
+
+            std::string keyword;
+            bool legal = true;
+            if (fields >> keyword && keyword == "moves") {
+                stix::Move move;
+                while (legal && fields >> std::ws && !fields.eof()) {
+                    legal = stix::parse_move(fields, position, move);
+                    if (legal) {
+                        position.move(move);
+                        position.player_id = (stix::PlayerID) !position.player_id;
+                    }
+                }
+            }
+            if (!legal || (!keyword.empty() && keyword != "moves")) {
+                say("error illegal move");
+                continue;
+            }
+            game.game_state[stix::PLAYER_A] = position.game_state[stix::PLAYER_A];
+            game.game_state[stix::PLAYER_B] = position.game_state[stix::PLAYER_B];
+            game.player_id = position.player_id;
+        } else if (command == "go") {
+            stop();
+            unsigned int depth = stix::max_ply;
+            auto deadline = std::chrono::steady_clock::time_point::max();
+            stix::Game searcher = game;
+            searcher.node_budget = 0;
+
+            std::string key;
+            uint64_t value;
+            while (fields >> key >> value) {
+                if (key == "depth") {
+                    depth = std::max<uint64_t>(std::min<uint64_t>(value, stix::max_ply), 1);
+                } else if (key == "movetime") {
+                    deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(value);
+                } else if (key == "nodes") {
+                    searcher.node_budget = value;
+                }
+            }
+
+            // Reports come from the search thread after every depth and once it finishes, bestmove always being last
+            std::shared_ptr<EngineSearch> current(new EngineSearch);
+            current->previous = search;
+            std::weak_ptr<EngineSearch> weak = current;
+            searcher.progress = [info, weak, searcher](const stix::BestMove& best_move, const stix::SearchStats& stats) mutable {
+                if (auto current = weak.lock()) {
+                    current->follow();
+                    info(searcher, best_move, stats, std::chrono::duration<double>(std::chrono::steady_clock::now() - current->start).count());
+                    current->reported = true;
+                }
+            };
+            auto on_update = [weak](const stix::BestMove& best_move) {
+                if (auto current = weak.lock()) {
+                    current->best_move = best_move;
+                    current->found = true;
+                }
+            };
+            auto on_finish = [info, say, current, searcher]() mutable {
+                current->follow();
+                if (!current->found) {
+                    say("bestmove none");
+                } else {
+                    const stix::BestMove& best_move = current->best_move;
+                    if (!current->reported) {
+                        info(searcher, best_move, stix::SearchStats(), 0.);
+                    }
+                    std::ostringstream ret;
+                    ret << "bestmove " << stix::move_string(best_move);
+                    if (best_move.solved) {
+                        ret << " solved " << (best_move.outcome == stix::OUTCOME_WIN ? "win" : best_move.outcome == stix::OUTCOME_LOSS ? "loss" : "draw");
+                    }
+                    say(ret.str());
+                }
+                current->finish();
+                current.reset();
+            };
+            current->job = stix::detail::controller.submit(searcher, stix::PLAYER_NONE, 1, depth, deadline, on_update, on_finish);
+            search = current;
+        } else {
+            say("error unknown command " + command);
+        }
+    }
+
+    // The last search only finishes after every one before it, and they all use the table and output
+    stop();
+    if (search) {
+        search->wait();
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--batch") {
+        return batch(argc, argv);
+    } else if (argc > 1 && std::string(argv[1]) == "--engine") {
+        return engine(argc, argv);
+    }
+
     stix::Game game(stix::PLAYER_B);
+    if (!(argc > 1 && std::string(argv[1]) == "--no-tablebase")) {
+        game.tablebase = &stix::Tablebase::standard();
+    }
+
+    // The computer ponders on the player's expected move while they type, the table keeps that work even when the
+    // player does something else
+    stix::TranspositionTable tt;
+    game.tt = &tt;
+    stix::SearchHandle search;
+    bool pondering = false;
+    stix::StateIndex ponder_state = 0;
 
     while ((game.game_state[stix::PLAYER_A][stix::HAND_R] + game.game_state[stix::PLAYER_A][stix::HAND_L] > 0) &&
            (game.game_state[stix::PLAYER_B][stix::HAND_R] + game.game_state[stix::PLAYER_B][stix::HAND_L] > 0)) {
@@ -18,7 +326,23 @@ int main() {
 
         std::cout << ">> " << std::flush;
         std::string command;
-        std::cin >> command;
+        if (!(std::cin >> command)) {
+            break;
+        }
+
+        if (command == "hint") {
+            // One search scores every move
+            for (const stix::RankedMove& ranked : game.rank_moves(16, SIZE_MAX, stix::PLAYER_A)) {
+                std::cout << stix::move_string(ranked.move) << " # ";
+                if (stix::is_decided(ranked.score)) {
+                    std::cout << (ranked.score > 0 ? "Wins" : "Loses") << " in " << stix::score_distance(ranked.score) << " plies";
+                } else {
+                    std::cout << "Score " << ranked.score;
+                }
+                std::cout << std::endl;
+            }
+            continue;
+        }
 
         stix::Move move;
         if (command == "attack") {
@@ -83,14 +407,37 @@ int main() {
         }
 
         std::cout << "Computer's turn" << std::endl;
-        stix::BestMove computer_move = game.find_best_move(std::chrono::seconds(2));
+        if (!pondering || stix::pack_state(game.game_state) != ponder_state) {
+            search.start(game, stix::PLAYER_B, 10);
+        }
+        search.wait_for(std::chrono::seconds(2));
+        search.wait_for_result();
+        search.stop();
+
+        stix::BestMove computer_move;
+        if (!search.poll(computer_move)) {
+            break;
+        }
         game.move(computer_move);
-        if (computer_move.from_player == computer_move.to_player) {
-            std::cout << "<< split " << (computer_move.from_hand == stix::HAND_L ? 'l' : 'r') << ' ' << (computer_move.to_hand == stix::HAND_L ? 'l' : 'r') << ' ' << +computer_move.amount;
+        std::cout << "<< " << stix::move_string(computer_move);
+        if (computer_move.solved) {
+            if (computer_move.outcome == stix::OUTCOME_DRAW) {
+                std::cout << " # Solved, drawn\n";
+            } else {
+                std::cout << " # Solved, " << (computer_move.outcome == stix::OUTCOME_WIN ? "win" : "loss") << " in " << computer_move.depth << " plies\n";
+            }
         } else {
-            std::cout << "<< attack " << (computer_move.from_hand == stix::HAND_L ? 'l' : 'r') << ' ' << (computer_move.to_hand == stix::HAND_L ? 'l' : 'r');
+            std::cout << " # Found at " << computer_move.depth << " depth\n";
+        }
+
+        stix::Move expected_move;
+        pondering = game.evaluate(stix::PLAYER_A) == 0 && game.expected_move(expected_move, stix::PLAYER_A);
+        if (pondering) {
+            stix::Game ponder_game = game;
+            ponder_game.move(expected_move);
+            ponder_state = stix::pack_state(ponder_game.game_state);
+            search.start(ponder_game, stix::PLAYER_B, 10);
         }
-        std::cout << " # Found at " << computer_move.depth << " depth\n";
     }
 
     std::cout << "Game over!" << std::endl;
@@ -0,0 +1,143 @@
+#include "stix.hpp"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Leaf counts from the starting position with player A to move, index is the depth
+const uint64_t start_counts[] = {
+    1,
+    6,
+    32,
+    160,
+    804,
+    3632,
+    16824,
+    77080,
+    359072,
+    1667800,
+    7705360,
+    35584168,
+    165013208,
+    764966864,
+};
+
+constexpr unsigned int known_depth = sizeof(start_counts) / sizeof(start_counts[0]) - 1;
+
+struct Options {
+    unsigned int depth = 8;
+    bool parallel = false;
+    bool divide = false;
+    stix::Player players[2] = {{1, 1}, {1, 1}};
+    stix::PlayerID to_move = stix::PLAYER_A;
+};
+
+template <typename RulesT>
+uint64_t perft(stix::BasicGame<RulesT>& game, unsigned int depth, bool parallel) {
+    uint64_t ret = 0;
+    for (const auto& [move, count] : game.perft_divide(depth, parallel)) {
+        ret += count;
+    }
+    return depth == 0 ? 1 : ret;
+}
+
+// Checks the serial and parallel counts of every known depth up to max_depth
+int verify(unsigned int max_depth) {
+    int ret = 0;
+    for (unsigned int depth = 1; depth <= max_depth && depth <= known_depth; depth++) {
+        stix::Game game(stix::PLAYER_A);
+        uint64_t serial = game.perft(depth);
+        uint64_t parallel = perft(game, depth, true);
+
+        bool ok = serial == start_counts[depth] && parallel == start_counts[depth];
+        std::cout << "depth " << depth << ": " << serial << ' ' << parallel << " expected " << start_counts[depth] << (ok ? " ok" : " MISMATCH") << std::endl;
+        if (!ok) {
+            ret = 1;
+        }
+    }
+    return ret;
+}
+
+template <typename RulesT>
+int run(const Options& options) {
+    stix::BasicGame<RulesT> game(options.to_move);
+    for (auto player : {stix::PLAYER_A, stix::PLAYER_B}) {
+        for (auto hand : {stix::HAND_L, stix::HAND_R}) {
+            game.game_state[player][hand] = options.players[player][hand] % RulesT::modulus;
+        }
+    }
+    unsigned int depth = options.depth;
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t nodes = 0;
+    if (options.divide) {
+        for (const auto& [move, count] : game.perft_divide(depth, options.parallel)) {
+            std::cout << stix::move_string(move) << ": " << count << std::endl;
+            nodes += count;
+        }
+        nodes = depth == 0 ? 1 : nodes;
+    } else {
+        nodes = options.parallel ? perft(game, depth, true) : game.perft(depth);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Nodes: " << nodes << std::endl;
+    std::cout << "Seconds: " << seconds << std::endl;
+    std::cout << "Nodes/second: " << (seconds > 0. ? nodes / seconds : 0.) << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    std::string variant = "standard";
+    bool check = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--parallel") {
+            options.parallel = true;
+        } else if (arg == "--divide") {
+            options.divide = true;
+        } else if (arg == "--verify") {
+            check = true;
+        } else if (arg == "--position" && i + 5 < argc) {
+            // Hands of player A, hands of player B, then the player to move
+            for (auto player : {stix::PLAYER_A, stix::PLAYER_B}) {
+                for (auto hand : {stix::HAND_L, stix::HAND_R}) {
+                    options.players[player][hand] = std::stoi(argv[++i]);
+                }
+            }
+            std::string to_move = argv[++i];
+            options.to_move = to_move == "b" || to_move == "B" ? stix::PLAYER_B : stix::PLAYER_A;
+        } else if (arg == "--variant" && i + 1 < argc) {
+            variant = argv[++i];
+        } else if (arg[0] != '-') {
+            options.depth = std::stoul(arg);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [depth] [--divide] [--parallel] [--position AL AR BL BR A|B] [--variant NAME] [--verify]" << std::endl;
+            std::cerr << "NAME is one of standard, cutoff, suicide-splits, no-transfers, mod-4, mod-6" << std::endl;
+            return 1;
+        }
+    }
+
+    if (check) {
+        return verify(options.depth);
+    }
+
+    // Each variant is compiled into its own move tables
+    if (variant == "standard") {
+        return run<stix::StandardRules>(options);
+    } else if (variant == "cutoff") {
+        return run<stix::Rules<5, false>>(options);
+    } else if (variant == "suicide-splits") {
+        return run<stix::Rules<5, true, true, true>>(options);
+    } else if (variant == "no-transfers") {
+        return run<stix::Rules<5, true, false>>(options);
+    } else if (variant == "mod-4") {
+        return run<stix::Rules<4>>(options);
+    } else if (variant == "mod-6") {
+        return run<stix::Rules<6>>(options);
+    }
+    std::cerr << "Unknown variant: " << variant << std::endl;
+    return 1;
+}
@@ -0,0 +1,569 @@
+#include "stix.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sstream>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// Line protocol, one game per connection:
+//   position AL AR BL BR a|b            -> ok
+//   move attack L|R L|R                 -> ok
+//   move split L|R L|R N                -> ok
+//   go [time MS] [nodes N] [depth N]    -> bestmove MOVE score S depth D [solved win|loss|draw], the move is played
+// Moves are made by the player to move, who then passes the turn
+//   show                                -> position AL AR BL BR a|b
+//   stats                               -> stats ...
+//   quit
+// Anything else gets "error ..." back
+
+struct Options {
+    std::string unix_path;
+    std::string host = "127.0.0.1";
+    unsigned short port = 7777;
+    unsigned int time = 100;    // Milliseconds per search, also the most a client can ask for
+    uint64_t nodes = 0;         // Node budget per search, also the most a client can ask for, 0 for no budget
+    unsigned int searches = 0;  // Searches running at once, 0 for the size of the thread pool
+    unsigned int threads = 0;   // Size of the search thread pool, 0 for the hardware concurrency
+    unsigned int search_threads = 0; // Threads one search may keep busy, 0 for the whole pool
+    std::vector<tp::CpuSet> affinity; // CPUs the pool's threads are pinned to in turn, empty to let them float
+    double report = 0.;         // Seconds between reports on stdout, 0 to only report on exit
+    bool use_tablebase = true;
+    const stix::SolutionFile* solution = nullptr; // Mapped results of stix-solve, used instead of solving the tablebase at startup
+};
+
+struct Session {
+    uint64_t id;
+    int fd;
+    stix::Game game;
+    std::string input;
+    std::string output;
+    bool closing = false;
+    bool writable = true;
+
+    // The search asked for by the last go, queued until a search slot is free
+    bool waiting = false;
+    unsigned int time;
+    uint64_t nodes;
+    unsigned int depth;
+    std::chrono::steady_clock::time_point requested;
+    std::shared_ptr<stix::SearchJob> search;
+
+    Session(uint64_t id, int fd) :
+        id(id),
+        fd(fd),
+        game(stix::PLAYER_A) { }
+};
+
+// Request latencies and counts, reset by every report
+struct Metrics {
+    std::vector<double> latencies; // Milliseconds from go to bestmove
+    uint64_t requests = 0;
+    uint64_t solved = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    double percentile(double fraction) {
+        if (latencies.empty()) {
+            return 0.;
+        }
+        size_t index = std::min(latencies.size() - 1, (size_t) (fraction * latencies.size()));
+        std::nth_element(latencies.begin(), latencies.begin() + index, latencies.end());
+        return latencies[index];
+    }
+
+    std::string summary(size_t sessions) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::ostringstream ret;
+        ret << std::fixed << std::setprecision(3) << "sessions " << sessions << " requests " << requests << " solved " << solved
+            << " throughput " << (seconds > 0. ? requests / seconds : 0.)
+            << " p50 " << percentile(0.5) << " p90 " << percentile(0.9) << " p99 " << percentile(0.99) << " max " << percentile(1.);
+        return ret.str();
+    }
+};
+
+volatile std::sig_atomic_t quit = 0;
+
+void on_signal(int) {
+    quit = 1;
+}
+
+class Server {
+public:
+    Server(const Options& options) :
+        options(options),
+        pool(options.threads ? options.threads : std::thread::hardware_concurrency(), tp::SchedulingPolicy::WorkStealing, options.affinity) {
+        tablebase = options.use_tablebase && !options.solution ? &stix::Tablebase::standard() : nullptr;
+        max_searches = options.searches ? options.searches : std::max<unsigned int>(pool.size(), 1);
+    }
+
+    ~Server() {
+        for (auto& [fd, session] : sessions) {
+            if (session->search) {
+                session->search->stop_flag = true;
+            }
+            close(fd);
+        }
+
+        // Searches of dropped sessions were stopped too, every one has to report back before the members go away
+        {
+            std::unique_lock<std::mutex> lock(finished_mutex);
+            finished_condition.wait(lock, [this]() { return finished.size() >= running; });
+            finished.clear();
+            running = 0;
+        }
+
+        if (listen_fd >= 0) {
+            close(listen_fd);
+            if (!options.unix_path.empty()) {
+                unlink(options.unix_path.c_str());
+            }
+        }
+        if (wake_fd >= 0) {
+            close(wake_fd);
+        }
+        if (epoll_fd >= 0) {
+            close(epoll_fd);
+        }
+    }
+
+    bool listen() {
+        if (!options.unix_path.empty()) {
+            sockaddr_un address = {};
+            address.sun_family = AF_UNIX;
+            if (options.unix_path.size() >= sizeof(address.sun_path)) {
+                std::cerr << "Socket path too long: " << options.unix_path << std::endl;
+                return false;
+            }
+            strcpy(address.sun_path, options.unix_path.c_str());
+            unlink(address.sun_path);
+
+            listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (listen_fd < 0 || bind(listen_fd, (sockaddr*) &address, sizeof(address)) < 0) {
+                perror("bind");
+                return false;
+            }
+        } else {
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(options.port);
+            if (inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1) {
+                std::cerr << "Invalid address: " << options.host << std::endl;
+                return false;
+            }
+
+            listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            int reuse = 1;
+            if (listen_fd < 0 || setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0 ||
+                bind(listen_fd, (sockaddr*) &address, sizeof(address)) < 0) {
+                perror("bind");
+                return false;
+            }
+        }
+        if (::listen(listen_fd, SOMAXCONN) < 0) {
+            perror("listen");
+            return false;
+        }
+
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll_fd < 0 || wake_fd < 0) {
+            perror("epoll");
+            return false;
+        }
+        watch(listen_fd, EPOLLIN, EPOLL_CTL_ADD);
+        watch(wake_fd, EPOLLIN, EPOLL_CTL_ADD);
+        return true;
+    }
+
+    void run() {
+        auto next_report = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.report));
+        epoll_event events[256];
+        while (!quit) {
+            int timeout = -1;
+            if (options.report > 0.) {
+                timeout = std::max<int>(0, std::chrono::duration_cast<std::chrono::milliseconds>(next_report - std::chrono::steady_clock::now()).count());
+            }
+
+            int count = epoll_wait(epoll_fd, events, 256, timeout);
+            if (count < 0 && errno != EINTR) {
+                perror("epoll_wait");
+                break;
+            }
+            for (int i = 0; i < count; i++) {
+                int fd = events[i].data.fd;
+                if (fd == listen_fd) {
+                    accept_all();
+                } else if (fd == wake_fd) {
+                    uint64_t value;
+                    while (read(wake_fd, &value, sizeof(value)) > 0) { }
+                    collect();
+                } else if (auto it = sessions.find(fd); it != sessions.end()) {
+                    Session& session = *it->second;
+                    if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                        receive(session);
+                    }
+                    if (events[i].events & EPOLLOUT) {
+                        session.writable = true;
+                        update(session);
+                        send(session);
+                    }
+                    if (idle(session)) {
+                        drop(session);
+                    }
+                }
+            }
+            start_searches();
+
+            if (options.report > 0. && std::chrono::steady_clock::now() >= next_report) {
+                std::cout << metrics.summary(sessions.size()) << std::endl;
+                metrics = Metrics();
+                next_report += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.report));
+            }
+        }
+        std::cout << metrics.summary(sessions.size()) << std::endl;
+    }
+
+protected:
+    Options options;
+    tp::ThreadPool pool; // Runs every session's searches
+    const stix::Tablebase* tablebase;
+    stix::TranspositionTable tt; // Shared by every session
+    unsigned int max_searches;
+
+    int listen_fd = -1;
+    int epoll_fd = -1;
+    int wake_fd = -1;
+
+    uint64_t next_id = 0;
+    std::unordered_map<int, std::unique_ptr<Session>> sessions;
+    std::unordered_map<uint64_t, Session*> sessions_by_id;
+    std::deque<uint64_t> waiting;  // Sessions waiting for a search slot, in the order they asked
+    unsigned int running = 0;
+
+    // Written by the search threads when a search finishes
+    std::mutex finished_mutex;
+    std::condition_variable finished_condition;
+    std::vector<uint64_t> finished;
+
+    Metrics metrics;
+
+    void watch(int fd, uint32_t events, int operation) {
+        epoll_event event = {};
+        event.events = events;
+        event.data.fd = fd;
+        epoll_ctl(epoll_fd, operation, fd, &event);
+    }
+
+    void accept_all() {
+        for (;;) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    perror("accept");
+                }
+                return;
+            }
+            if (options.unix_path.empty()) {
+                int nodelay = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+            }
+
+            auto session = std::make_unique<Session>(next_id++, fd);
+            session->game.tt = &tt;
+            session->game.tablebase = tablebase;
+            session->game.solution = options.solution;
+            session->game.pool = &pool;
+            session->game.thread_budget = options.search_threads;
+            sessions_by_id[session->id] = session.get();
+            sessions[fd] = std::move(session);
+            watch(fd, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+        }
+    }
+
+    // A closing session is kept until its search has been answered and the answer has been sent
+    bool idle(const Session& session) const {
+        return session.closing && session.output.empty() && !session.waiting && !session.search;
+    }
+
+    void update(Session& session) {
+        uint32_t events = session.closing ? 0 : EPOLLIN | EPOLLRDHUP;
+        watch(session.fd, session.writable ? events : events | EPOLLOUT, EPOLL_CTL_MOD);
+    }
+
+    void drop(Session& session) {
+        if (session.search) {
+            // The search finishes in the background and its result is ignored
+            session.search->stop_flag = true;
+        }
+        if (session.waiting) {
+            waiting.erase(std::find(waiting.begin(), waiting.end(), session.id));
+        }
+        close(session.fd);
+        sessions_by_id.erase(session.id);
+        sessions.erase(session.fd);
+    }
+
+    void receive(Session& session) {
+        char buffer[4096];
+        bool end_of_input = false;
+        for (;;) {
+            ssize_t size = read(session.fd, buffer, sizeof(buffer));
+            if (size > 0) {
+                session.input.append(buffer, size);
+            } else if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else if (size < 0 && errno == EINTR) {
+                continue;
+            } else if (size == 0) {
+                // The client may have only closed its side, so whatever it asked for so far is still answered
+                end_of_input = true;
+                break;
+            } else {
+                session.closing = true;
+                session.output.clear();
+                update(session);
+                return;
+            }
+        }
+
+        size_t start = 0;
+        for (size_t end; (end = session.input.find('\n', start)) != std::string::npos; start = end + 1) {
+            handle(session, session.input.substr(start, end - start));
+        }
+        session.input.erase(0, start);
+        if (session.input.size() > 4096) {
+            reply(session, "error line too long");
+            session.closing = true;
+        }
+        session.closing = session.closing || end_of_input;
+        update(session);
+        send(session);
+    }
+
+    void reply(Session& session, const std::string& line) {
+        session.output += line;
+        session.output += '\n';
+    }
+
+    void send(Session& session) {
+        while (session.writable && !session.output.empty()) {
+            ssize_t size = ::send(session.fd, session.output.data(), session.output.size(), MSG_NOSIGNAL);
+            if (size > 0) {
+                session.output.erase(0, size);
+            } else if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                // Wait for the socket to drain before writing the rest
+                session.writable = false;
+                update(session);
+                return;
+            } else if (size < 0 && errno == EINTR) {
+                continue;
+            } else {
+                session.closing = true;
+                session.output.clear();
+                update(session);
+                return;
+            }
+        }
+    }
+
+    void handle(Session& session, const std::string& line) {
+        std::istringstream fields(line);
+        std::string command;
+        if (session.closing || !(fields >> command)) {
+            return;
+        }
+
+        bool busy = session.waiting || session.search;
+        if (command == "quit") {
+            session.closing = true;
+            if (session.search) {
+                session.search->stop_flag = true;
+            }
+        } else if (command == "stats") {
+            reply(session, "stats " + metrics.summary(sessions.size()));
+        } else if (command == "show") {
+            const stix::Game& game = session.game;
+            std::ostringstream ret;
+            ret << "position " << +game.game_state[stix::PLAYER_A][stix::HAND_L] << ' ' << +game.game_state[stix::PLAYER_A][stix::HAND_R] << ' '
+                << +game.game_state[stix::PLAYER_B][stix::HAND_L] << ' ' << +game.game_state[stix::PLAYER_B][stix::HAND_R] << ' '
+                << (game.player_id == stix::PLAYER_A ? 'a' : 'b');
+            reply(session, ret.str());
+        } else if (busy && (command == "position" || command == "move" || command == "go")) {
+            reply(session, "error searching");
+        } else if (command == "position") {
+            if (!stix::parse_position(fields, session.game.game_state, session.game.player_id)) {
+                reply(session, "error expected position AL AR BL BR a|b");
+                return;
+            }
+            reply(session, "ok");
+        } else if (command == "move") {
+            stix::Move move;
+            if (!stix::parse_move(fields, session.game, move)) {
+                reply(session, "error illegal move");
+                return;
+            }
+            session.game.move(move);
+            session.game.player_id = (stix::PlayerID) !session.game.player_id;
+            reply(session, "ok");
+        } else if (command == "go") {
+            session.time = options.time;
+            session.nodes = options.nodes;
+            session.depth = stix::max_ply;
+
+            std::string key;
+            uint64_t value;
+            while (fields >> key >> value) {
+                // Clients can only ask for less than the server's budget, so every session gets the same share
+                if (key == "time") {
+                    session.time = std::min<uint64_t>(value, options.time);
+                } else if (key == "nodes") {
+                    session.nodes = options.nodes ? std::min(value, options.nodes) : value;
+                } else if (key == "depth") {
+                    session.depth = std::max<uint64_t>(std::min<uint64_t>(value, stix::max_ply), 1);
+                }
+            }
+
+            session.waiting = true;
+            session.requested = std::chrono::steady_clock::now();
+            waiting.push_back(session.id);
+        } else {
+            reply(session, "error unknown command " + command);
+        }
+    }
+
+    // Starts waiting searches in the order they were asked for while there are free slots
+    void start_searches() {
+        while (running < max_searches && !waiting.empty()) {
+            Session& session = *sessions_by_id.at(waiting.front());
+            waiting.pop_front();
+            session.waiting = false;
+
+            session.game.node_budget = session.nodes;
+            uint64_t id = session.id;
+            running++;
+            session.search = stix::detail::controller.submit(
+                session.game, stix::PLAYER_NONE, 1, session.depth, std::chrono::steady_clock::now() + std::chrono::milliseconds(session.time), nullptr, [this, id]() {
+                    std::lock_guard<std::mutex> lock(finished_mutex);
+                    finished.push_back(id);
+                    uint64_t value = 1;
+                    ssize_t size = write(wake_fd, &value, sizeof(value));
+                    (void) size;
+                    finished_condition.notify_one(); // Under the lock, the server may be gone as soon as it is released
+                });
+        }
+    }
+
+    // Answers the sessions whose searches have finished
+    void collect() {
+        std::vector<uint64_t> ids;
+        {
+            std::lock_guard<std::mutex> lock(finished_mutex);
+            ids.swap(finished);
+        }
+
+        for (uint64_t id : ids) {
+            running--;
+            auto it = sessions_by_id.find(id);
+            if (it == sessions_by_id.end()) {
+                continue;
+            }
+            Session& session = *it->second;
+
+            stix::BestMove best_move;
+            if (!session.search->poll(best_move)) {
+                reply(session, "bestmove none");
+            } else {
+                session.game.move(best_move);
+                session.game.player_id = (stix::PlayerID) !session.game.player_id;
+
+                std::ostringstream ret;
+                ret << "bestmove " << stix::move_string(best_move) << " score " << best_move.score << " depth " << best_move.depth;
+                if (best_move.solved) {
+                    ret << " solved " << (best_move.outcome == stix::OUTCOME_WIN ? "win" : best_move.outcome == stix::OUTCOME_LOSS ? "loss" : "draw");
+                    metrics.solved++;
+                }
+                reply(session, ret.str());
+            }
+            session.search.reset();
+
+            metrics.requests++;
+            metrics.latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - session.requested).count());
+            send(session);
+            if (idle(session)) {
+                drop(session);
+            }
+        }
+    }
+};
+
+int main(int argc, char** argv) {
+    Options options;
+    stix::SolutionFile solution;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--unix" && i + 1 < argc) {
+            options.unix_path = argv[++i];
+        } else if (arg == "--host" && i + 1 < argc) {
+            options.host = argv[++i];
+        } else if (arg == "--port" && i + 1 < argc) {
+            options.port = std::stoul(argv[++i]);
+        } else if (arg == "--time" && i + 1 < argc) {
+            options.time = std::stoul(argv[++i]);
+        } else if (arg == "--nodes" && i + 1 < argc) {
+            options.nodes = std::stoull(argv[++i]);
+        } else if (arg == "--searches" && i + 1 < argc) {
+            options.searches = std::stoul(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = std::stoul(argv[++i]);
+        } else if (arg == "--search-threads" && i + 1 < argc) {
+            options.search_threads = std::stoul(argv[++i]);
+        } else if (arg == "--affinity" && i + 1 < argc && (std::string(argv[i + 1]) == "cpu" || std::string(argv[i + 1]) == "numa")) {
+            options.affinity = std::string(argv[++i]) == "cpu" ? tp::cpu_affinity() : tp::numa_affinity();
+        } else if (arg == "--report" && i + 1 < argc) {
+            options.report = std::stod(argv[++i]);
+        } else if (arg == "--no-tablebase") {
+            options.use_tablebase = false;
+        } else if (arg == "--solution" && i + 1 < argc) {
+            if (!solution.open(argv[++i])) {
+                std::cerr << "Cannot open " << argv[i] << ": " << strerror(errno) << std::endl;
+                return 1;
+            }
+            options.solution = &solution;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--unix PATH | --host ADDRESS --port PORT] [--time MS] [--nodes N] [--searches N]"
+                      << " [--threads N] [--search-threads N] [--affinity cpu|numa] [--report SECONDS] [--no-tablebase] [--solution FILE]" << std::endl;
+            return 1;
+        }
+    }
+
+    struct sigaction action = {};
+    action.sa_handler = on_signal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    Server server(options);
+    if (!server.listen()) {
+        return 1;
+    }
+    server.run();
+    return 0;
+}
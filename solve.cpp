@@ -0,0 +1,114 @@
+#include "stix.hpp"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+struct Options {
+    std::string path;
+    unsigned int threads = 0; // 0 for the hardware concurrency
+    bool verify = false;
+};
+
+// Solves the variant into the file, or finishes the solve an earlier run left in it, then summarizes the result
+template <typename RulesT>
+int run(const Options& options) {
+    typedef stix::BasicSolutionFile<RulesT> SolutionFile;
+
+    tp::ThreadPool pool(options.threads ? options.threads : std::thread::hardware_concurrency(), tp::SchedulingPolicy::WorkStealing);
+    auto start = std::chrono::steady_clock::now();
+    bool solved = SolutionFile::solve(options.path, pool, [](unsigned int ply, uint64_t resolved) {
+        std::cout << "ply " << ply << ": " << resolved << " positions" << std::endl;
+    });
+    if (!solved) {
+        std::cerr << "Cannot solve into " << options.path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    SolutionFile file;
+    if (!file.open(options.path)) {
+        std::cerr << "Cannot open " << options.path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    uint64_t counts[3] = {};
+    unsigned int longest = 0;
+    for (uint64_t position = 0; position < SolutionFile::position_count; position++) {
+        counts[file.result(position)]++;
+        longest = std::max<unsigned int>(longest, file.distance(position));
+    }
+    std::cout << "Positions: " << SolutionFile::position_count << " won " << counts[SolutionFile::RESULT_WIN] << " lost " << counts[SolutionFile::RESULT_LOSS]
+              << " drawn " << counts[SolutionFile::RESULT_UNKNOWN] << std::endl;
+    std::cout << "Longest: " << longest << " plies" << std::endl;
+    std::cout << "Seconds: " << seconds << std::endl;
+
+    if (options.verify) {
+        // The in-memory tablebase solves the same variant by a different method
+        const stix::BasicTablebase<RulesT>& tablebase = stix::BasicTablebase<RulesT>::standard();
+        uint64_t mismatches = 0;
+        for (stix::StateIndex state = 0; state < RulesT::state_count; state++) {
+            for (auto to_move : {stix::PLAYER_A, stix::PLAYER_B}) {
+                auto expected = tablebase.probe(state, to_move);
+                auto entry = file.probe(state, to_move);
+                mismatches += entry.outcome != expected.outcome || entry.distance != expected.distance || entry.best_move != expected.best_move;
+            }
+        }
+        std::cout << "Verify: " << mismatches << " mismatches" << (mismatches ? "" : " ok") << std::endl;
+
+        // The proof-number search settles the starting position by search alone, a draw in the standard game
+        const char* outcome_names[] = {"loss", "draw", "win"};
+        stix::BasicGame<RulesT> game(stix::PLAYER_A);
+        game.search_mode = stix::SearchMode::ProofNumber;
+        game.pool = &pool;
+        stix::BestMove proven = game.find_best_move_to_depth(26);
+        auto expected = file.probe(RulesT::pack_state(game.game_state), stix::PLAYER_A);
+        bool start_ok = !proven.solved || proven.outcome == expected.outcome;
+        std::cout << "Start: " << (proven.solved ? outcome_names[proven.outcome + 1] : "not settled") << " expected " << outcome_names[expected.outcome + 1]
+                  << (!proven.solved ? "" : start_ok ? " ok" : " MISMATCH") << std::endl;
+        return mismatches != 0 || !start_ok;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    std::string variant = "standard";
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            options.threads = std::stoul(argv[++i]);
+        } else if (arg == "--variant" && i + 1 < argc) {
+            variant = argv[++i];
+        } else if (arg == "--verify") {
+            options.verify = true;
+        } else if (arg[0] != '-' && options.path.empty()) {
+            options.path = arg;
+        } else {
+            options.path.clear();
+            break;
+        }
+    }
+    if (options.path.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--variant NAME] [--threads N] [--verify] FILE" << std::endl;
+        std::cerr << "NAME is one of standard, cutoff, suicide-splits, no-transfers, mod-4, mod-6" << std::endl;
+        std::cerr << "Rules go up to modulus 6, at most 1296 states and 2592 positions per file" << std::endl;
+        return 1;
+    }
+
+    if (variant == "standard") {
+        return run<stix::StandardRules>(options);
+    } else if (variant == "cutoff") {
+        return run<stix::Rules<5, false>>(options);
+    } else if (variant == "suicide-splits") {
+        return run<stix::Rules<5, true, true, true>>(options);
+    } else if (variant == "no-transfers") {
+        return run<stix::Rules<5, true, false>>(options);
+    } else if (variant == "mod-4") {
+        return run<stix::Rules<4>>(options);
+    } else if (variant == "mod-6") {
+        return run<stix::Rules<6>>(options);
+    }
+    std::cerr << "Unknown variant: " << variant << std::endl;
+    return 1;
+}
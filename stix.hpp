@@ -2,16 +2,35 @@
 #include <algorithm>
 #include <atomic>
 #include <boost/container/static_vector.hpp>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <errno.h>
+#include <fcntl.h>
+#include <functional>
+#include <istream>
 #include <iterator>
 #include <limits.h>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <stdint.h>
 #include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <thread>
+#include <unistd.h>
 #include <utility>
+#include <vector>
 
 namespace stix {
-    namespace detail {
-        tp::ThreadPool pool; // NOLINT
+    // Runs the tasks of searches that are not given a pool of their own. Started on first use rather than at program
+    // start, and never destroyed so searches still running while the program exits can keep using it
+    inline tp::ThreadPool& default_pool() {
+        static tp::ThreadPool* pool = new tp::ThreadPool(std::thread::hardware_concurrency(), tp::SchedulingPolicy::WorkStealing);
+        return *pool;
     }
 
     typedef int8_t Hand;
@@ -27,7 +46,7 @@ namespace stix {
         HAND_R = 1
     };
 
-    inline PlayerID opposite_player(PlayerID player_id) {
+    constexpr PlayerID opposite_player(PlayerID player_id) {
         return (PlayerID) !((int8_t) player_id);
     }
 
@@ -35,67 +54,67 @@ namespace stix {
     public:
         Hand hands[2];
 
-        inline Hand& operator[](HandID hand) {
+        constexpr Hand& operator[](HandID hand) {
             return hands[hand];
         }
 
-        inline const Hand& operator[](HandID hand) const {
+        constexpr const Hand& operator[](HandID hand) const {
             return hands[hand];
         }
 
-        inline Hand& operator[](uint8_t hand) {
+        constexpr Hand& operator[](uint8_t hand) {
             return hands[hand];
         }
 
-        inline const Hand& operator[](uint8_t hand) const {
+        constexpr const Hand& operator[](uint8_t hand) const {
             return hands[hand];
         }
 
-        inline bool operator==(Player player) const {
+        constexpr bool operator==(Player player) const {
             return ((this->hands[HAND_L] == player.hands[HAND_L]) && (this->hands[HAND_R] == player.hands[HAND_R])) ||
                    ((this->hands[HAND_L] == player.hands[HAND_R]) && (this->hands[HAND_R] == player.hands[HAND_L]));
         }
 
-        inline bool operator!=(Player player) const {
+        constexpr bool operator!=(Player player) const {
             return !(*this == player);
         }
     };
 
     class Move {
     public:
-        PlayerID from_player;
-        HandID from_hand;
+        PlayerID from_player = PLAYER_NONE;
+        HandID from_hand = HAND_L;
 
-        PlayerID to_player;
-        HandID to_hand;
+        PlayerID to_player = PLAYER_NONE;
+        HandID to_hand = HAND_L;
 
         uint8_t amount = 1;
 
         Move() = default;
-        Move(PlayerID from_player, HandID from_hand, PlayerID to_player, HandID to_hand) :
+        constexpr Move(PlayerID from_player, HandID from_hand, PlayerID to_player, HandID to_hand) :
             from_player(from_player),
             from_hand(from_hand),
             to_player(to_player),
             to_hand(to_hand) { }
-        Move(PlayerID from_player, uint8_t from_hand, PlayerID to_player, uint8_t to_hand) :
+        constexpr Move(PlayerID from_player, uint8_t from_hand, PlayerID to_player, uint8_t to_hand) :
             from_player(from_player),
             from_hand((HandID) from_hand),
             to_player(to_player),
             to_hand((HandID) to_hand) { }
-        Move(PlayerID from_player, HandID from_hand, PlayerID to_player, HandID to_hand, uint8_t amount) :
+        constexpr Move(PlayerID from_player, HandID from_hand, PlayerID to_player, HandID to_hand, uint8_t amount) :
             from_player(from_player),
             from_hand(from_hand),
             to_player(to_player),
             to_hand(to_hand),
             amount(amount) { }
-        Move(PlayerID from_player, uint8_t from_hand, PlayerID to_player, uint8_t to_hand, uint8_t amount) :
+        constexpr Move(PlayerID from_player, uint8_t from_hand, PlayerID to_player, uint8_t to_hand, uint8_t amount) :
             from_player(from_player),
             from_hand((HandID) from_hand),
             to_player(to_player),
             to_hand((HandID) to_hand),
             amount(amount) { }
 
-        inline bool operator==(const Move& move) const {
+        constexpr bool operator==(const Move& move) const {
             return from_player == move.from_player &&
                    from_hand == move.from_hand &&
                    to_player == move.to_player &&
@@ -103,7 +122,7 @@ namespace stix {
                    amount == move.amount;
         }
 
-        inline bool operator!=(const Move& move) const {
+        constexpr bool operator!=(const Move& move) const {
             return from_player != move.from_player ||
                    from_hand != move.from_hand ||
                    to_player != move.to_player ||
@@ -112,9 +131,19 @@ namespace stix {
         }
     };
 
+    enum Outcome : int8_t {
+        OUTCOME_LOSS = -1,
+        OUTCOME_DRAW = 0,
+        OUTCOME_WIN = 1
+    };
+
     class BestMove: public Move {
     public:
         unsigned int depth = 0;
+        bool solved = false;            // Proven by the tablebase or the search, depth is the distance to the result. A proof-number
+                                        // search gives the length of the proof it found, which may be longer than the quickest
+        Outcome outcome = OUTCOME_DRAW; // Only meaningful when solved
+        int score = 0;                  // From the perspective of the player to move, see score_win
 
         BestMove() = default;
         BestMove(const Move& move, unsigned int depth = 0) :
@@ -124,27 +153,75 @@ namespace stix {
 
     typedef Player GameState[2];
 
-    class Game {
-    public:
-        GameState game_state = {{1, 1}, {1, 1}};
-        PlayerID player_id;
+    // Positions are packed as base modulus digits, player A's left hand being the most significant
+    typedef uint16_t StateIndex;
 
-        Game(PlayerID player_id) :
-            player_id(player_id) { }
+    constexpr unsigned int max_ply = 1024;
 
-        inline void move(Move move) {
+    // A win n plies from the root scores score_win - n so faster wins score higher and slower losses score lower,
+    // anything closer to zero than a decided score is a heuristic evaluation
+    constexpr int score_win = 2000;
+    constexpr int score_infinity = score_win + 1;
+
+    constexpr bool is_decided(int score) {
+        return score > score_win - (int) max_ply || score < -(score_win - (int) max_ply);
+    }
+
+    // Plies until the game ends for a decided score
+    constexpr unsigned int score_distance(int score) {
+        return score_win - (score < 0 ? -score : score);
+    }
+
+    // A rule variant, chosen at compile time so the move tables, tablebase and search kernels of each variant are
+    // built for it and never check a rule while searching. A hand holds 0 to Modulus - 1 fingers, one that reaches
+    // Modulus wraps around with Rollover and is emptied without it. Transfers allow splitting into a hand that is not
+    // empty, SuicideSplits allow splits that push the receiving hand to Modulus or past it
+    template <uint8_t Modulus, bool Rollover = true, bool Transfers = true, bool SuicideSplits = false>
+    struct Rules {
+        static_assert(Modulus >= 2 && Modulus <= 6, "larger move tables exceed the compiler's constant evaluation limits");
+
+        static constexpr uint8_t modulus = Modulus;
+        static constexpr bool rollover = Rollover;
+        static constexpr bool transfers = Transfers;
+        static constexpr bool suicide_splits = SuicideSplits;
+
+        static constexpr unsigned int state_count = Modulus * Modulus * Modulus * Modulus;
+        static constexpr uint8_t move_code_count = 4 + 2 * (Modulus - 1);
+
+        // Fingers on a hand after it receives more
+        static constexpr Hand add(Hand hand, Hand fingers) {
+            if constexpr (Rollover) {
+                return (hand + fingers) % Modulus;
+            } else {
+                return hand + fingers >= Modulus ? 0 : hand + fingers;
+            }
+        }
+
+        static constexpr StateIndex pack_state(const GameState& game_state) {
+            return ((game_state[PLAYER_A][HAND_L] * Modulus + game_state[PLAYER_A][HAND_R]) * Modulus + game_state[PLAYER_B][HAND_L]) * Modulus + game_state[PLAYER_B][HAND_R];
+        }
+
+        static constexpr void unpack_state(StateIndex state, GameState& game_state) {
+            game_state[PLAYER_A][HAND_L] = state / (Modulus * Modulus * Modulus);
+            game_state[PLAYER_A][HAND_R] = state / (Modulus * Modulus) % Modulus;
+            game_state[PLAYER_B][HAND_L] = state / Modulus % Modulus;
+            game_state[PLAYER_B][HAND_R] = state % Modulus;
+        }
+
+        static constexpr void apply_move(GameState& game_state, Move move) {
             if (move.from_player != move.to_player) {
-                game_state[move.to_player][move.to_hand] = (game_state[move.to_player][move.to_hand] + game_state[move.from_player][move.from_hand]) % 5;
+                game_state[move.to_player][move.to_hand] = add(game_state[move.to_player][move.to_hand], game_state[move.from_player][move.from_hand]);
             } else {
-                game_state[move.to_player][move.to_hand] += move.amount;
+                game_state[move.to_player][move.to_hand] = add(game_state[move.to_player][move.to_hand], move.amount);
                 game_state[move.from_player][move.from_hand] -= move.amount;
             }
         }
 
         template <typename InsertIt>
-        void find_all_moves(InsertIt ret, PlayerID player_id = PLAYER_NONE) {
-            if (player_id == PLAYER_NONE) {
-                player_id = this->player_id;
+        static constexpr void generate_moves(const GameState& game_state, PlayerID player_id, InsertIt ret) {
+            // The game is over once either player has lost both hands, which a suicide split does on the mover's turn
+            if ((game_state[PLAYER_A][HAND_L] == 0 && game_state[PLAYER_A][HAND_R] == 0) || (game_state[PLAYER_B][HAND_L] == 0 && game_state[PLAYER_B][HAND_R] == 0)) {
+                return;
             }
 
             // Attacks
@@ -158,190 +235,2966 @@ namespace stix {
                 }
             }
 
-            // Splits
-            Player new_player = game_state[player_id];
-
-            for (;;) {
-                new_player[HAND_L]--;
-                new_player[HAND_R]++;
-                if (new_player[HAND_L] >= 0 && new_player[HAND_R] < 5) {
-                    if (new_player != game_state[player_id]) {
-                        ret = Move(player_id, HAND_L, player_id, HAND_R, new_player[HAND_R] - game_state[player_id][HAND_R]);
+            // Splits, left to right then right to left in increasing amounts. Splits that only swap the hands are not
+            // moves
+            const Player& player = game_state[player_id];
+            for (uint8_t from = 0; from < 2; from++) {
+                uint8_t to = !from;
+                if constexpr (!Transfers) {
+                    if (player[to] != 0) {
+                        continue;
                     }
-                } else {
-                    break;
                 }
-            }
 
-            new_player = game_state[player_id];
-            for (;;) {
-                new_player[HAND_R]--;
-                new_player[HAND_L]++;
-                if (new_player[HAND_R] >= 0 && new_player[HAND_L] < 5) {
-                    if (new_player != game_state[player_id]) {
-                        ret = Move(player_id, HAND_R, player_id, HAND_L, new_player[HAND_L] - game_state[player_id][HAND_L]);
+                for (Hand amount = 1; amount <= player[from]; amount++) {
+                    if constexpr (!SuicideSplits) {
+                        if (player[to] + amount >= Modulus) {
+                            break;
+                        }
+                    }
+
+                    if (player[from] - amount != player[to] || add(player[to], amount) != player[from]) {
+                        ret = Move(player_id, from, player_id, to, amount);
                     }
-                } else {
-                    break;
                 }
             }
         }
 
-        inline int evaluate(PlayerID player_id = PLAYER_NONE) {
-            if (player_id == PLAYER_NONE) {
-                player_id = this->player_id;
-            }
-
-            if (game_state[PLAYER_A][HAND_L] + game_state[PLAYER_A][HAND_R] <= 0) {
+        // 1 if player_id has won in state, -1 if it has lost and 0 while both players have a hand left
+        static constexpr int evaluate(StateIndex state, PlayerID player_id) {
+            if (state / (Modulus * Modulus) == 0) { // Both of player A's hands are empty
                 return player_id == PLAYER_A ? -1 : 1;
-            } else if (game_state[PLAYER_B][HAND_L] + game_state[PLAYER_B][HAND_R] <= 0) {
+            } else if (state % (Modulus * Modulus) == 0) {
                 return player_id == PLAYER_B ? -1 : 1;
             } else {
                 return 0;
             }
         }
 
-        int maxi(Move move, int alpha, int beta, unsigned int depth, const std::atomic<bool>& stop_flag, PlayerID player_id = PLAYER_NONE) {
-            if (player_id == PLAYER_NONE) {
-                player_id = this->player_id;
+        // Index of a move among the moves one side can make, for history tables
+        static constexpr uint8_t move_code(const Move& move) {
+            if (move.from_player == move.to_player) {
+                return 4 + move.from_hand * (Modulus - 1) + (move.amount - 1);
+            } else {
+                return move.from_hand * 2 + move.to_hand;
             }
+        }
+    };
 
-            GameState old_game_state;
-            memcpy(old_game_state, game_state, sizeof(GameState));
-            this->move(move);
+    namespace detail {
+        struct MoveCounter {
+            uint8_t* count;
 
-            if (depth == 0) {
-                int evaluation = evaluate(player_id);
-                memcpy(game_state, old_game_state, sizeof(GameState));
-                return evaluation;
+            constexpr MoveCounter& operator=(const Move&) {
+                ++*count;
+                return *this;
             }
+        };
 
-            boost::container::static_vector<Move, 32> moves;
-            find_all_moves(std::back_inserter(moves), player_id);
-
-            int ret;
-            if (moves.size() == 0) {
-                ret = -1;
-                goto cutoff;
-            } else {
-                for (Move move : moves) {
-                    int score = mini(move, alpha, beta, depth - 1, stop_flag, player_id);
-                    if (stop_flag) {
-                        memcpy(game_state, old_game_state, sizeof(GameState));
-                        return alpha;
-                    } else if (score >= beta) {
-                        ret = beta;
-                        goto cutoff;
-                    } else if (score > alpha) {
-                        alpha = score;
-                    }
+        // Most moves one side has in any position of a variant, which sizes its move lists
+        template <typename RulesT>
+        constexpr unsigned int most_moves() {
+            unsigned int ret = 0;
+            for (unsigned int state = 0; state < RulesT::state_count; state++) {
+                GameState game_state = {};
+                RulesT::unpack_state(state, game_state);
+                for (uint8_t player_id = 0; player_id < 2; player_id++) {
+                    uint8_t count = 0;
+                    RulesT::generate_moves(game_state, (PlayerID) player_id, MoveCounter {&count});
+                    ret = std::max<unsigned int>(ret, count);
                 }
-                ret = alpha;
             }
-
-        cutoff:
-            memcpy(game_state, old_game_state, sizeof(GameState));
             return ret;
         }
+    } // namespace detail
 
-        int mini(Move move, int alpha, int beta, unsigned int depth, const std::atomic<bool>& stop_flag, PlayerID player_id = PLAYER_NONE) {
-            if (player_id == PLAYER_NONE) {
-                player_id = this->player_id;
+    // Hands wrap around at five, and a split may move any number of fingers as long as the receiving hand stays below five
+    typedef Rules<5> StandardRules;
+
+    constexpr unsigned int state_count = StandardRules::state_count;
+    constexpr unsigned int max_moves = detail::most_moves<StandardRules>();
+
+    constexpr StateIndex pack_state(const GameState& game_state) {
+        return StandardRules::pack_state(game_state);
+    }
+
+    constexpr void unpack_state(StateIndex state, GameState& game_state) {
+        StandardRules::unpack_state(state, game_state);
+    }
+
+    constexpr void apply_move(GameState& game_state, Move move) {
+        StandardRules::apply_move(game_state, move);
+    }
+
+    template <typename InsertIt>
+    constexpr void generate_moves(const GameState& game_state, PlayerID player_id, InsertIt ret) {
+        StandardRules::generate_moves(game_state, player_id, ret);
+    }
+
+    // Reads "l" or "r" in either case
+    inline bool parse_hand(const std::string& str, HandID& ret) {
+        if (str == "l" || str == "L") {
+            ret = HAND_L;
+        } else if (str == "r" || str == "R") {
+            ret = HAND_R;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Reads "AL AR BL BR a|b" from fields, false without changing game_state or to_move unless every hand holds 0 to
+    // Modulus - 1 fingers
+    template <typename RulesT = StandardRules>
+    bool parse_position(std::istream& fields, GameState& game_state, PlayerID& to_move) {
+        int hands[4];
+        std::string player;
+        if (!(fields >> hands[0] >> hands[1] >> hands[2] >> hands[3] >> player) || (player != "a" && player != "A" && player != "b" && player != "B")) {
+            return false;
+        }
+        for (int hand : hands) {
+            if (hand < 0 || hand >= RulesT::modulus) {
+                return false;
             }
+        }
 
-            GameState old_game_state;
-            memcpy(old_game_state, game_state, sizeof(GameState));
-            this->move(move);
+        game_state[PLAYER_A] = {(Hand) hands[0], (Hand) hands[1]};
+        game_state[PLAYER_B] = {(Hand) hands[2], (Hand) hands[3]};
+        to_move = player == "b" || player == "B" ? PLAYER_B : PLAYER_A;
+        return true;
+    }
 
-            if (depth == 0) {
-                int evaluation = evaluate(player_id);
-                memcpy(game_state, old_game_state, sizeof(GameState));
-                return evaluation;
+    // Legal moves of one side in one position, and the positions they lead to
+    template <typename RulesT>
+    struct BasicSuccessors {
+        static constexpr unsigned int capacity = detail::most_moves<RulesT>();
+
+        uint8_t size = 0;
+        Move moves[capacity] = {};
+        StateIndex children[capacity] = {};
+    };
+
+    typedef BasicSuccessors<StandardRules> Successors;
+
+    namespace detail {
+        template <typename RulesT>
+        struct SuccessorInserter {
+            BasicSuccessors<RulesT>* successors;
+
+            constexpr SuccessorInserter& operator=(const Move& move) {
+                successors->moves[successors->size++] = move;
+                return *this;
             }
+        };
+    } // namespace detail
 
-            boost::container::static_vector<Move, 32> moves;
-            find_all_moves(std::back_inserter(moves), opposite_player(player_id));
+    struct CanonicalState {
+        StateIndex state = 0; // Each player's hands sorted in ascending order
+        bool swapped[2] = {};
+    };
 
-            int ret;
-            if (moves.size() == 0) {
-                ret = 1;
-                goto cutoff;
-            } else {
-                for (Move move : moves) {
-                    int score = maxi(move, alpha, beta, depth - 1, stop_flag, player_id);
-                    if (stop_flag) {
-                        memcpy(game_state, old_game_state, sizeof(GameState));
-                        return beta;
-                    } else if (score <= alpha) {
-                        ret = alpha;
-                        goto cutoff;
-                    } else if (score < beta) {
-                        beta = score;
+    template <typename RulesT>
+    class BasicMoveTable {
+    public:
+        typedef BasicSuccessors<RulesT> Successors;
+
+        Successors successors[RulesT::state_count][2];
+        Successors distinct[RulesT::state_count][2]; // The first move to each child that differs from the others by more than swapped hands
+        CanonicalState canonical[RulesT::state_count];
+
+        constexpr BasicMoveTable() {
+            for (unsigned int state = 0; state < RulesT::state_count; state++) {
+                GameState game_state = {};
+                RulesT::unpack_state(state, game_state);
+
+                for (uint8_t player_id = 0; player_id < 2; player_id++) {
+                    Successors& entry = successors[state][player_id];
+                    RulesT::generate_moves(game_state, (PlayerID) player_id, detail::SuccessorInserter<RulesT> {&entry});
+
+                    for (uint8_t i = 0; i < entry.size; i++) {
+                        GameState child = {game_state[PLAYER_A], game_state[PLAYER_B]};
+                        RulesT::apply_move(child, entry.moves[i]);
+                        entry.children[i] = RulesT::pack_state(child);
+                    }
+                }
+
+                GameState sorted = {game_state[PLAYER_A], game_state[PLAYER_B]};
+                for (uint8_t player_id = 0; player_id < 2; player_id++) {
+                    canonical[state].swapped[player_id] = game_state[player_id][HAND_L] > game_state[player_id][HAND_R];
+                    sorted[player_id][HAND_L] = game_state[player_id][canonical[state].swapped[player_id]];
+                    sorted[player_id][HAND_R] = game_state[player_id][!canonical[state].swapped[player_id]];
+                }
+                canonical[state].state = RulesT::pack_state(sorted);
+            }
+
+            for (unsigned int state = 0; state < RulesT::state_count; state++) {
+                for (uint8_t player_id = 0; player_id < 2; player_id++) {
+                    const Successors& entry = successors[state][player_id];
+                    Successors& reduced = distinct[state][player_id];
+                    for (uint8_t i = 0; i < entry.size; i++) {
+                        StateIndex child = canonical[entry.children[i]].state;
+                        bool duplicate = false;
+                        for (uint8_t j = 0; j < reduced.size && !duplicate; j++) {
+                            duplicate = canonical[reduced.children[j]].state == child;
+                        }
+                        if (!duplicate) {
+                            reduced.moves[reduced.size] = entry.moves[i];
+                            reduced.children[reduced.size++] = entry.children[i];
+                        }
                     }
                 }
-                ret = beta;
             }
+        }
+    };
+
+    template <typename RulesT>
+    inline constexpr BasicMoveTable<RulesT> rules_move_table;
+
+    typedef BasicMoveTable<StandardRules> MoveTable;
+
+    inline constexpr const MoveTable& move_table = rules_move_table<StandardRules>;
+
+    template <typename RulesT>
+    class BasicTablebase {
+    public:
+        struct Entry {
+            Outcome outcome = OUTCOME_DRAW; // From the perspective of the player to move
+            uint16_t distance = 0;          // Plies until the outcome is forced
+            Move best_move;
+        };
+
+        BasicTablebase() {
+            solve();
+        }
+
+        // The tablebase of this variant, solved once on first use
+        static const BasicTablebase& standard() {
+            static BasicTablebase tablebase;
+            return tablebase;
+        }
+
+        inline const Entry& probe(StateIndex state, PlayerID to_move) const {
+            return entries[state * 2 + to_move];
+        }
+
+        inline const Entry& probe(const GameState& game_state, PlayerID to_move) const {
+            return probe(RulesT::pack_state(game_state), to_move);
+        }
+
+    protected:
+        Entry entries[RulesT::state_count * 2];
+
+        void solve();
+    };
+
+    typedef BasicTablebase<StandardRules> Tablebase;
+
+    // Retrograde results kept in a memory-mapped file instead of memory, two bits of outcome per position followed by a
+    // separate array of 16 bit distances, both indexed by state * 2 + player to move. Solving works one ply at a time on
+    // every pool thread and records each ply it finishes in the header, so an interrupted solve resumes with the ply it
+    // was in. Opening a finished file maps it read-only, so every engine process shares one copy in the page cache. The
+    // rules cap it like everything else here, at modulus 6 and 16 bit state indices, so the largest file holds 1296
+    // states, 2592 positions, and needs no more than a few kilobytes
+    template <typename RulesT>
+    class BasicSolutionFile {
+    public:
+        typedef typename BasicTablebase<RulesT>::Entry Entry;
+
+        enum Result : uint8_t {
+            RESULT_UNKNOWN = 0, // A draw once the file is complete
+            RESULT_WIN = 1,
+            RESULT_LOSS = 2
+        };
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint8_t rules[4]; // Modulus, rollover, transfers and suicide splits of the variant
+            uint64_t position_count;
+            uint32_t plies;    // Plies of analysis whose results are on disk, the terminal positions being ply 0
+            uint32_t complete; // Set once a ply resolves nothing new
+        };
+
+        static constexpr char magic[8] = "STIXSOL";
+        static constexpr uint32_t version = 1;
+        static constexpr uint64_t position_count = (uint64_t) RulesT::state_count * 2;
+        static constexpr size_t results_offset = 64;
+        static constexpr size_t distances_offset = (results_offset + (position_count + 3) / 4 + 7) / 8 * 8;
+        static constexpr size_t file_size = distances_offset + position_count * sizeof(uint16_t);
+
+        BasicSolutionFile() = default;
+        BasicSolutionFile(const BasicSolutionFile&) = delete;
+        BasicSolutionFile& operator=(const BasicSolutionFile&) = delete;
+
+        ~BasicSolutionFile() {
+            close();
+        }
+
+        // Maps a complete solution of this variant read-only, returns false with errno set otherwise
+        bool open(const std::string& path) {
+            close();
+            if (!map(path, false)) {
+                return false;
+            } else if (!header().complete) {
+                close();
+                errno = EINVAL;
+                return false;
+            }
+            return true;
+        }
+
+        void close() {
+            if (data) {
+                munmap(data, file_size);
+                data = nullptr;
+            }
+        }
+
+        inline bool is_open() const {
+            return data != nullptr;
+        }
+
+        inline const Header& header() const {
+            return *(const Header*) data;
+        }
+
+        inline Result result(uint64_t position) const {
+            return (Result) ((data[results_offset + position / 4] >> (position % 4 * 2)) & 3);
+        }
 
-        cutoff:
-            memcpy(game_state, old_game_state, sizeof(GameState));
+        inline uint16_t distance(uint64_t position) const {
+            return ((const uint16_t*) (data + distances_offset))[position];
+        }
+
+        // The entry the tablebase would have, the best move is found among the successors when probed
+        Entry probe(StateIndex state, PlayerID to_move) const {
+            Entry ret;
+            uint64_t position = (uint64_t) state * 2 + to_move;
+            ret.outcome = outcome(result(position));
+            ret.distance = distance(position);
+
+            GameState game_state;
+            RulesT::unpack_state(state, game_state);
+            boost::container::static_vector<Move, BasicSuccessors<RulesT>::capacity> moves;
+            RulesT::generate_moves(game_state, to_move, std::back_inserter(moves));
+            for (const Move& move : moves) {
+                GameState child = {game_state[PLAYER_A], game_state[PLAYER_B]};
+                RulesT::apply_move(child, move);
+                uint64_t child_position = (uint64_t) RulesT::pack_state(child) * 2 + opposite_player(to_move);
+                if (outcome(result(child_position)) == -ret.outcome && (ret.outcome == OUTCOME_DRAW || distance(child_position) + 1 == ret.distance)) {
+                    ret.best_move = move;
+                    break;
+                }
+            }
             return ret;
         }
 
-        template <typename DurationT>
-        BestMove find_best_move(DurationT search_time, unsigned int starting_depth = 10, PlayerID player_id = PLAYER_NONE) {
-            if (player_id == PLAYER_NONE) {
-                player_id = this->player_id;
+        inline Entry probe(const GameState& game_state, PlayerID to_move) const {
+            return probe(RulesT::pack_state(game_state), to_move);
+        }
+
+        // Solves the variant into the file at path, creating it or resuming the solve it holds. Moves come from the rules
+        // alone, without move tables or predecessor lists, leaving the file and the lists of positions each ply resolves
+        // as the only things that grow with the variant. progress is called after every ply with the ply and the
+        // positions it resolved. Returns false with errno set if the file cannot be mapped, belongs to another
+        // variant or cannot be synced
+        static bool solve(const std::string& path, tp::ThreadPool& pool, std::function<void(unsigned int, uint64_t)> progress = nullptr) {
+            BasicSolutionFile file;
+            if (!file.map(path, true)) {
+                return false;
+            }
+            Header& header = *(Header*) file.data;
+            if (!header.complete) {
+                file.discard_unfinished(header.plies);
             }
 
-            boost::container::static_vector<Move, 32> moves;
-            find_all_moves(std::back_inserter(moves), player_id);
+            // Blocks are a multiple of four positions, so blocks written at once never share a byte
+            constexpr uint64_t block_size = 1 << 14;
+            constexpr uint64_t block_count = (position_count + block_size - 1) / block_size;
+            std::vector<std::vector<uint64_t>> wins(block_count);
+            std::vector<std::vector<uint64_t>> losses(block_count);
+            std::vector<uint64_t> resolved(block_count);
 
-            BestMove ret;
-            std::atomic<bool> stop(false);
+            for (unsigned int ply = header.plies; !header.complete; ply++) {
+                // Every block is read before any is written, so a ply only sees the results of earlier plies
+                tp::TaskGroup group(pool);
+                for (uint64_t block = 0; block < block_count; block++) {
+                    group.run([&file, &wins, &losses, &resolved, block, ply]() {
+                        file.resolve(block * block_size, std::min((block + 1) * block_size, position_count), ply, wins[block], losses[block], resolved[block]);
+                    });
+                }
+                group.wait();
+                for (uint64_t block = 0; block < block_count; block++) {
+                    group.run([&file, &wins, &losses, block, ply]() {
+                        file.store(wins[block], RESULT_WIN, ply);
+                        file.store(losses[block], RESULT_LOSS, ply);
+                    });
+                }
+                group.wait();
 
-            std::thread deepening_thread([this, starting_depth, &moves, player_id, &stop, &ret]() {
-                for (unsigned int depth = starting_depth; !stop; depth++) {
-                    Move best_move;
-                    int best_move_score = INT_MIN;
-                    std::mutex mtx;
-
-                    std::vector<std::shared_ptr<tp::Task>> tasks;
-                    for (auto& move : moves) {
-                        tasks.push_back(detail::pool.schedule(
-                            [move, depth, &stop, player_id, &mtx, &best_move, &best_move_score](void* data) {
-                                Game* game = (Game*) data;
-                                Game copy = *game;
-
-                                int score = copy.mini(move, INT_MIN, INT_MAX, depth - 1, stop, player_id);
-
-                                if (!stop) {
-                                    mtx.lock();
-                                    if (score > best_move_score) {
-                                        best_move = move;
-                                        best_move_score = score;
-                                    }
-                                    mtx.unlock();
-                                }
-                            },
-                            this));
-                    }
+                // The results reach the disk before the header says they are there
+                uint64_t total = 0;
+                for (uint64_t count : resolved) {
+                    total += count;
+                }
+                if (msync(file.data, file_size, MS_SYNC) != 0) {
+                    return false;
+                }
+                header.plies = ply + 1;
+                header.complete = ply != 0 && total == 0;
+                if (msync(file.data, results_offset, MS_SYNC) != 0) {
+                    return false;
+                }
+
+                if (progress) {
+                    progress(ply, total);
+                }
+            }
+            return true;
+        }
+
+    protected:
+        uint8_t* data = nullptr;
+
+        static constexpr Outcome outcome(Result result) {
+            return result == RESULT_WIN ? OUTCOME_WIN : (result == RESULT_LOSS ? OUTCOME_LOSS : OUTCOME_DRAW);
+        }
+
+        // Maps the file at path, a writable mapping creates the file if it does not exist yet
+        bool map(const std::string& path, bool writable) {
+            int fd = ::open(path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+            if (fd < 0) {
+                return false;
+            }
+
+            struct stat st;
+            bool fresh = false;
+            if (fstat(fd, &st) != 0) {
+                int error = errno;
+                ::close(fd);
+                errno = error;
+                return false;
+            } else if (writable && st.st_size == 0) {
+                fresh = true;
+                if (ftruncate(fd, file_size) != 0) {
+                    int error = errno;
+                    ::close(fd);
+                    errno = error;
+                    return false;
+                }
+            } else if ((size_t) st.st_size != file_size) {
+                ::close(fd);
+                errno = EINVAL;
+                return false;
+            }
+
+            // The mapping keeps the file open
+            void* mapping = mmap(nullptr, file_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+            int error = errno;
+            ::close(fd);
+            if (mapping == MAP_FAILED) {
+                errno = error;
+                return false;
+            }
+            data = (uint8_t*) mapping;
+
+            Header expected = {};
+            memcpy(expected.magic, magic, sizeof(magic));
+            expected.version = version;
+            expected.rules[0] = RulesT::modulus;
+            expected.rules[1] = RulesT::rollover;
+            expected.rules[2] = RulesT::transfers;
+            expected.rules[3] = RulesT::suicide_splits;
+            expected.position_count = position_count;
+            if (fresh) {
+                memcpy(data, &expected, sizeof(expected));
+            } else if (memcmp(header().magic, expected.magic, sizeof(magic)) != 0 || header().version != version ||
+                       memcmp(header().rules, expected.rules, sizeof(expected.rules)) != 0 || header().position_count != position_count) {
+                close();
+                errno = EINVAL;
+                return false;
+            }
+            return true;
+        }
 
-                    for (const auto& task : tasks) {
-                        task->await();
+        // Finds the positions in [begin, end) that are decided at ply, counting the ones an interrupted solve already
+        // stored. A successor counts only if it was decided at an earlier ply
+        void resolve(uint64_t begin, uint64_t end, unsigned int ply, std::vector<uint64_t>& wins, std::vector<uint64_t>& losses, uint64_t& resolved) const {
+            wins.clear();
+            losses.clear();
+            resolved = 0;
+            for (uint64_t position = begin; position < end; position++) {
+                if (result(position) != RESULT_UNKNOWN) {
+                    resolved += distance(position) == ply;
+                    continue;
+                }
+
+                StateIndex state = position / 2;
+                PlayerID to_move = (PlayerID) (position % 2);
+                if (ply == 0) {
+                    int evaluation = RulesT::evaluate(state, to_move);
+                    if (evaluation != 0) {
+                        (evaluation > 0 ? wins : losses).push_back(position);
                     }
+                    continue;
+                }
+
+                GameState game_state;
+                RulesT::unpack_state(state, game_state);
+                boost::container::static_vector<Move, BasicSuccessors<RulesT>::capacity> moves;
+                RulesT::generate_moves(game_state, to_move, std::back_inserter(moves));
 
-                    if (!stop) {
-                        ret = BestMove(best_move, depth);
+                bool win = false;
+                bool loss = !moves.empty();
+                for (const Move& move : moves) {
+                    GameState child = {game_state[PLAYER_A], game_state[PLAYER_B]};
+                    RulesT::apply_move(child, move);
+                    uint64_t child_position = (uint64_t) RulesT::pack_state(child) * 2 + opposite_player(to_move);
+                    Result child_result = result(child_position);
+                    bool known = child_result != RESULT_UNKNOWN && distance(child_position) < ply;
+                    if (known && child_result == RESULT_LOSS) {
+                        win = true;
+                        break;
                     }
+                    loss = loss && known;
                 }
-            });
 
-            std::this_thread::sleep_for(search_time);
-            while (ret.depth == 0) { std::this_thread::sleep_for(std::chrono::milliseconds(100)); }
-            stop = true;
-            deepening_thread.join();
+                if (win) {
+                    wins.push_back(position);
+                } else if (loss) {
+                    losses.push_back(position);
+                }
+            }
+            resolved += wins.size() + losses.size();
+        }
+
+        // The distance goes in before the result, so a result never stands with the zero distance of a fresh file
+        void store(const std::vector<uint64_t>& positions, Result result, unsigned int ply) {
+            uint16_t* distances = (uint16_t*) (data + distances_offset);
+            for (uint64_t position : positions) {
+                distances[position] = ply;
+                data[results_offset + position / 4] |= result << (position % 4 * 2);
+            }
+        }
+
+        // Clears whatever an interrupted solve left of the ply it was in. The pages of that ply may have reached the
+        // disk in any order, so a result can be there without its distance: results of the unfinished ply and results
+        // claiming ply 0 for a position that is not over both go
+        void discard_unfinished(unsigned int plies) {
+            uint16_t* distances = (uint16_t*) (data + distances_offset);
+            for (uint64_t position = 0; position < position_count; position++) {
+                if (result(position) != RESULT_UNKNOWN &&
+                    (distances[position] >= plies || (distances[position] == 0 && RulesT::evaluate(position / 2, (PlayerID) (position % 2)) == 0))) {
+                    data[results_offset + position / 4] &= ~(3 << (position % 4 * 2));
+                    distances[position] = 0;
+                }
+            }
+        }
+    };
+
+    typedef BasicSolutionFile<StandardRules> SolutionFile;
+
+    class TranspositionTable {
+    public:
+        enum Bound : uint8_t {
+            BOUND_NONE = 0,
+            BOUND_EXACT = 1,
+            BOUND_LOWER = 2,
+            BOUND_UPPER = 3
+        };
+
+        // Canonical position key, the hands of each player are sorted so mirrored positions share an entry
+        struct Key {
+            uint32_t key;
+            PlayerID to_move;
+            bool swapped[2];
+        };
+
+        struct Entry {
+            int score;
+            unsigned int depth;
+            Bound bound;
+            Move best_move;
+            bool has_best_move;
+            bool path_dependent; // Found with repetitions above the position scoring draws, so only holds along that path
+        };
+
+        TranspositionTable(size_t size = 1 << 16) {
+            // Round up to a power of two so the index is a mask
+            this->size = 1;
+            while (this->size < size) this->size <<= 1;
+            slots.reset(new std::atomic<uint64_t>[this->size]);
+            clear();
+        }
+
+        template <typename RulesT = StandardRules>
+        static inline Key make_key(StateIndex state, PlayerID to_move) {
+            const CanonicalState& canonical = rules_move_table<RulesT>.canonical[state];
+            return {(uint32_t) canonical.state << 1 | to_move, to_move, {canonical.swapped[PLAYER_A], canonical.swapped[PLAYER_B]}};
+        }
+
+        template <typename RulesT = StandardRules>
+        static inline Key make_key(const GameState& game_state, PlayerID to_move) {
+            return make_key<RulesT>(RulesT::pack_state(game_state), to_move);
+        }
+
+        // Scores and bounds are given from the perspective of player_id, decided scores are counted from the root of a
+        // search ply plies above the position but stored relative to the position itself
+        bool probe(const Key& key, Entry& ret, PlayerID player_id, unsigned int ply = 0) {
+            uint64_t data = slots[index(key)].load(std::memory_order_relaxed);
+            if (data >> 32 != key.key || (Bound) (data >> 6 & 3) == BOUND_NONE) {
+                misses.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            hits.fetch_add(1, std::memory_order_relaxed);
+
+            ret.score = (int) ((int64_t) (data << 32) >> 52);
+            ret.depth = data >> 9 & 0x7FF;
+            ret.path_dependent = data >> 8 & 1;
+            ret.bound = (Bound) (data >> 6 & 3);
+            if (is_decided(ret.score)) {
+                ret.score += ret.score > 0 ? -(int) ply : (int) ply;
+            }
+            if (player_id != key.to_move) {
+                ret.score = -ret.score;
+                if (ret.bound != BOUND_EXACT) ret.bound = (Bound) (ret.bound ^ 1);
+            }
+
+            uint8_t amount = data >> 3 & 7;
+            ret.has_best_move = amount != 0;
+            if (ret.has_best_move) {
+                PlayerID from_player = key.to_move;
+                PlayerID to_player = (data & 1) ? from_player : opposite_player(from_player);
+                ret.best_move = Move(from_player,
+                    (uint8_t) ((data >> 1 & 1) ^ key.swapped[from_player]),
+                    to_player,
+                    (uint8_t) ((data >> 2 & 1) ^ key.swapped[to_player]),
+                    amount);
+            }
+            return true;
+        }
+
+        void store(const Key& key, int score, unsigned int depth, Bound bound, const Move* best_move, PlayerID player_id, unsigned int ply = 0, bool path_dependent = false) {
+            if (is_decided(score)) {
+                score += score > 0 ? (int) ply : -(int) ply;
+            }
+            if (player_id != key.to_move) {
+                score = -score;
+                if (bound != BOUND_EXACT) bound = (Bound) (bound ^ 1);
+            }
+
+            std::atomic<uint64_t>& slot = slots[index(key)];
+            uint64_t old_data = slot.load(std::memory_order_relaxed);
+            if (old_data >> 32 != key.key && (old_data >> 9 & 0x7FF) > depth) {
+                return; // Keep the deeper result of another position, a newer result for this one replaces it
+            }
+
+            uint64_t data = (uint64_t) key.key << 32 |
+                            (uint64_t) (score & 0xFFF) << 20 |
+                            (uint64_t) std::min(depth, 0x7FFu) << 9 |
+                            (uint64_t) path_dependent << 8 |
+                            (uint64_t) bound << 6;
+            if (best_move) {
+                data |= (uint64_t) (best_move->amount & 7) << 3 |
+                        (uint64_t) (best_move->to_hand ^ key.swapped[best_move->to_player]) << 2 |
+                        (uint64_t) (best_move->from_hand ^ key.swapped[best_move->from_player]) << 1 |
+                        (uint64_t) (best_move->from_player == best_move->to_player);
+            } else if (old_data >> 32 == key.key) {
+                data |= old_data & 0x3F; // Keep the old best move for ordering
+            }
+            slot.store(data, std::memory_order_relaxed);
+        }
+
+        void clear() {
+            for (size_t i = 0; i < size; i++) {
+                slots[i].store(0, std::memory_order_relaxed);
+            }
+            reset_counters();
+        }
+
+        void reset_counters() {
+            hits.store(0, std::memory_order_relaxed);
+            misses.store(0, std::memory_order_relaxed);
+        }
+
+        inline uint64_t hit_count() const {
+            return hits.load(std::memory_order_relaxed);
+        }
+
+        inline uint64_t miss_count() const {
+            return misses.load(std::memory_order_relaxed);
+        }
+
+        inline size_t capacity() const {
+            return size;
+        }
+
+    protected:
+        // Each slot packs key (32 bits), score (12), depth (11), path dependence (1), bound (2) and best move (6) so it can
+        // be read and written by any worker without locking
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+        size_t size;
+        std::atomic<uint64_t> hits {0};
+        std::atomic<uint64_t> misses {0};
+
+        inline size_t index(const Key& key) const {
+            uint64_t hash = key.key * UINT64_C(0x9E3779B97F4A7C15);
+            return (hash ^ hash >> 32) & (size - 1);
+        }
+    };
+
+    // Identifies a position together with the player to move
+    typedef uint16_t PositionKey;
+
+    constexpr PositionKey position_key(StateIndex state, PlayerID to_move) {
+        return state * 2 + to_move;
+    }
+
+    // Counters kept by each search worker
+    class SearchCounters {
+    public:
+        uint64_t nodes = 0;              // Interior nodes expanded
+        uint64_t leaves = 0;             // Positions scored by the static evaluation at the depth limit
+        uint64_t cutoffs = 0;            // Nodes where a move fell outside the window
+        uint64_t first_move_cutoffs = 0; // Cutoffs produced by the first move searched
+        uint64_t tt_probes = 0;          // Transposition table lookups, zero when searching without a table
+        uint64_t tt_hits = 0;
+
+        SearchCounters& operator+=(const SearchCounters& counters) {
+            nodes += counters.nodes;
+            leaves += counters.leaves;
+            cutoffs += counters.cutoffs;
+            first_move_cutoffs += counters.first_move_cutoffs;
+            tt_probes += counters.tt_probes;
+            tt_hits += counters.tt_hits;
+            return *this;
+        }
+
+        inline double cutoff_rate() const {
+            return nodes ? (double) cutoffs / nodes : 0.;
+        }
+
+        inline double first_move_cutoff_rate() const {
+            return cutoffs ? (double) first_move_cutoffs / cutoffs : 0.;
+        }
+
+        inline double tt_hit_rate() const {
+            return tt_probes ? (double) tt_hits / tt_probes : 0.;
+        }
+    };
 
+    // Counters of a whole search summed over its workers, with timings
+    class SearchStats: public SearchCounters {
+    public:
+        struct Depth {
+            unsigned int depth;
+            std::chrono::steady_clock::duration time; // Wall time of this iteration alone
+            uint64_t nodes;
+        };
+
+        std::vector<Depth> depths;                          // Every completed depth in order
+        std::vector<uint64_t> worker_nodes;                 // Nodes searched on each pool worker, the last entry counts the calling thread
+        std::chrono::steady_clock::duration queue_wait {}; // Time search tasks spent queued before a worker started them
+
+        inline std::chrono::steady_clock::duration time() const {
+            std::chrono::steady_clock::duration ret {};
+            for (const Depth& depth : depths) {
+                ret += depth.time;
+            }
             return ret;
         }
     };
+
+    // State owned by a single search worker
+    template <typename RulesT>
+    class BasicSearchContext {
+    public:
+        typedef BasicSuccessors<RulesT> Successors;
+
+        const std::atomic<bool>* stop_flag;
+        PlayerID player_id; // The maximizing player
+        boost::container::static_vector<PositionKey, max_ply + 1> path;
+        uint8_t occurrences[RulesT::state_count * 2] = {};
+        uint16_t first_seen[RulesT::state_count * 2]; // Path index of the earliest occurrence, while there is one
+
+        // Shallowest path index a repetition draw below the current node relied on. Scores of nodes above it depend on
+        // the path that led to them and go into the transposition table marked as such
+        uint16_t repetition_ply = UINT16_MAX;
+
+        // Move ordering, kept across iterations of the same search
+        Move killers[max_ply + 1][2];
+        uint32_t history[2][RulesT::move_code_count] = {};
+
+        SearchCounters stats;
+
+        BasicSearchContext(const std::atomic<bool>& stop_flag, PlayerID player_id) :
+            stop_flag(&stop_flag),
+            player_id(player_id) { }
+
+        // Prepares the context for a new search without reallocating it
+        void reset(const std::atomic<bool>& stop_flag, PlayerID player_id) {
+            this->stop_flag = &stop_flag;
+            this->player_id = player_id;
+            while (!path.empty()) {
+                pop();
+            }
+            repetition_ply = UINT16_MAX;
+            // Copying a cleared table is several times faster than assigning every move
+            static const Move no_killers[max_ply + 1][2];
+            memcpy(killers, no_killers, sizeof(killers));
+            memset(history, 0, sizeof(history));
+            stats = SearchCounters();
+        }
+
+        inline bool stopped() const {
+            return stop_flag->load(std::memory_order_relaxed);
+        }
+
+        inline void push(PositionKey position) {
+            if (occurrences[position]++ == 0) {
+                first_seen[position] = path.size();
+            }
+            path.push_back(position);
+        }
+
+        inline void pop() {
+            occurrences[path.back()]--;
+            path.pop_back();
+        }
+
+        // Records a move that refuted the window at the current ply
+        void reward(const Move& move, PlayerID side, unsigned int depth) {
+            Move* ply_killers = killers[path.size() - 1];
+            if (ply_killers[0] != move) {
+                ply_killers[1] = ply_killers[0];
+                ply_killers[0] = move;
+            }
+
+            uint32_t& entry = history[side][RulesT::move_code(move)];
+            entry += std::min(depth, 1024u) * std::min(depth, 1024u);
+            if (entry > 1 << 24) {
+                for (uint32_t& value : history[side]) {
+                    value /= 2;
+                }
+            }
+        }
+
+        // Orders moves as the transposition table move, then the killers of the current ply, then by history
+        void order(const Successors& successors, uint8_t* ret, const Move* tt_move, PlayerID side) const {
+            const Move* ply_killers = killers[path.size()];
+            uint32_t keys[Successors::capacity];
+            for (uint8_t i = 0; i < successors.size; i++) {
+                const Move& move = successors.moves[i];
+                if (tt_move && move == *tt_move) {
+                    keys[i] = UINT32_MAX;
+                } else if (move == ply_killers[0]) {
+                    keys[i] = UINT32_MAX - 1;
+                } else if (move == ply_killers[1]) {
+                    keys[i] = UINT32_MAX - 2;
+                } else {
+                    keys[i] = history[side][RulesT::move_code(move)];
+                }
+
+                // Insertion sort, stable so equal moves keep generation order
+                uint8_t j = i;
+                for (; j > 0 && keys[ret[j - 1]] < keys[i]; j--) {
+                    ret[j] = ret[j - 1];
+                }
+                ret[j] = i;
+            }
+        }
+    };
+
+    typedef BasicSearchContext<StandardRules> SearchContext;
+
+    namespace detail {
+        // Credits the nodes a context searches while in scope to the pool worker doing the search, threads outside the
+        // pool share the last slot
+        class WorkerCredit {
+        public:
+            WorkerCredit(const SearchCounters& counters, std::vector<std::atomic<uint64_t>>& worker_nodes, const tp::ThreadPool& pool) :
+                counters(counters),
+                worker_nodes(worker_nodes),
+                pool(pool),
+                start(counters.nodes) { }
+
+            ~WorkerCredit() {
+                int worker = pool.worker_index();
+                size_t slot = worker < 0 || (size_t) worker + 1 >= worker_nodes.size() ? worker_nodes.size() - 1 : worker;
+                worker_nodes[slot].fetch_add(counters.nodes - start, std::memory_order_relaxed);
+            }
+
+        protected:
+            const SearchCounters& counters;
+            std::vector<std::atomic<uint64_t>>& worker_nodes; // Atomic since a thread joining another search can help with this one
+            const tp::ThreadPool& pool;
+            uint64_t start;
+        };
+    } // namespace detail
+
+    // A move from the root position and its score at the last completed depth
+    struct RootMove {
+        Move move;
+        StateIndex state; // Position the move leads to
+        int score = INT_MIN;
+        bool exact = false; // Otherwise score is an upper bound
+        size_t context = 0; // SearchContext that searches this move under root splitting
+    };
+
+    // A root move ranked by rank_moves, the score is from the perspective of the player to move
+    struct RankedMove {
+        Move move;
+        int score;
+        bool exact;           // Otherwise score is an upper bound, the first multi_pv moves are always exact
+        unsigned int depth;
+        std::vector<Move> pv; // The move followed by the expected replies, as far as the transposition table knows them
+    };
+
+    // A position in the Monte Carlo search tree. The children of a node are consecutive in the arena and in the order
+    // of its successors, so a node needs no list of them
+    struct MCTSNode {
+        enum Expansion : uint8_t {
+            LEAF,
+            EXPANDING, // Claimed by a worker, or left a leaf for good once the arena is full
+            EXPANDED
+        };
+
+        std::atomic<uint64_t> visits {0}; // Playouts through the node, counting ones still running as losses
+        std::atomic<uint64_t> reward {0}; // Half points of the player who moved into the node, 2 for a win and 1 for a draw
+        uint32_t first_child = 0;         // Only meaningful once expanded
+        StateIndex state = 0;
+        uint8_t child_count = 0;
+        std::atomic<uint8_t> expansion {LEAF};
+    };
+
+    // Node arena shared by every worker of a Monte Carlo search, the root is node 0 and is expanded when the tree is reset
+    struct MCTSTree {
+        std::unique_ptr<MCTSNode[]> nodes;
+        size_t capacity = 0;
+        std::atomic<size_t> used {0};
+
+        // Clears the tree down to a root with children in the given states, reallocating only if the capacity changes
+        void reset(size_t capacity, StateIndex root, const StateIndex* children, uint8_t child_count) {
+            capacity = std::max<size_t>(capacity, child_count + 1);
+            if (capacity != this->capacity) {
+                nodes.reset(new MCTSNode[capacity]);
+                this->capacity = capacity;
+                used = 0;
+            }
+
+            clear(nodes[0], root);
+            nodes[0].first_child = 1;
+            nodes[0].child_count = child_count;
+            nodes[0].expansion = MCTSNode::EXPANDED;
+            for (uint8_t i = 0; i < child_count; i++) {
+                clear(nodes[i + 1], children[i]);
+            }
+            used = child_count + 1;
+        }
+
+        // Takes count consecutive nodes for the children of a node, returns false when the arena has no room left
+        bool allocate(size_t count, uint32_t& ret) {
+            size_t first = used.fetch_add(count, std::memory_order_relaxed);
+            if (first + count > capacity) {
+                return false;
+            }
+            ret = first;
+            return true;
+        }
+
+        static inline void clear(MCTSNode& node, StateIndex state) {
+            node.visits.store(0, std::memory_order_relaxed);
+            node.reward.store(0, std::memory_order_relaxed);
+            node.first_child = 0;
+            node.state = state;
+            node.child_count = 0;
+            node.expansion.store(MCTSNode::LEAF, std::memory_order_relaxed);
+        }
+    };
+
+    // How Monte Carlo playouts pick their moves
+    enum class PlayoutPolicy {
+        Random,      // Uniformly at random
+        Decisive,    // A move that wins at once when there is one, otherwise at random
+        AntiDecisive // As Decisive, but avoiding moves that let the opponent win at once whenever possible
+    };
+
+    // Settings of SearchMode::MCTS
+    struct MCTSSettings {
+        double exploration = 1.4;                             // UCT exploration constant
+        PlayoutPolicy playout_policy = PlayoutPolicy::Decisive;
+        unsigned int playout_limit = 200;                     // Plies after which a playout counts as a draw
+        size_t max_nodes = 1 << 20;                           // Capacity of the node arena, leaves stop expanding once it is full
+        uint64_t seed = 0;                                    // Playouts of each worker and depth are seeded from this
+    };
+
+    // Proof and disproof numbers of a position for one attacker, infinite once the attacker is proven to force a win
+    // from it or proven not to
+    struct ProofNumbers {
+        static constexpr uint8_t max_repeated = 4;
+
+        uint32_t pn = 1;
+        uint32_t dn = 1;
+        uint16_t distance = 0;            // Plies of the proof found once proven, not necessarily the quickest win
+        uint16_t dependency = UINT16_MAX; // Shallowest ply of the search path whose repetition a disproof rests on, if any
+        uint8_t repeated_count = 0;       // Path positions a disproof rests on, above max_repeated once too many to list
+        PositionKey repeated[max_repeated];
+
+        // Whether this disproof holds on more paths than other: whatever the path, then resting on fewer repetitions,
+        // then on deeper ones
+        bool rests_on_less(const ProofNumbers& other) const {
+            if (dependency == UINT16_MAX || other.dependency == UINT16_MAX) {
+                return other.dependency != UINT16_MAX;
+            }
+            return repeated_count != other.repeated_count ? repeated_count < other.repeated_count : dependency > other.dependency;
+        }
+
+        // Adds the repetitions another disproof rests on, other than of position, to these
+        void rest_on(const ProofNumbers& other, PositionKey position) {
+            for (uint8_t i = 0; i < other.repeated_count && repeated_count <= max_repeated; i++) {
+                if (other.repeated_count > max_repeated) {
+                    repeated_count = max_repeated + 1;
+                } else if (other.repeated[i] != position && std::find(repeated, repeated + repeated_count, other.repeated[i]) == repeated + repeated_count) {
+                    if (repeated_count < max_repeated) {
+                        repeated[repeated_count] = other.repeated[i];
+                    }
+                    repeated_count++;
+                }
+            }
+        }
+    };
+
+    // Settings of SearchMode::ProofNumber
+    struct ProofSettings {
+        size_t table_size = 1 << 16; // Entries of the proof table
+        double epsilon = 0.25;       // Threshold slack over the second best child, each helper thread adds as much again
+    };
+
+    // Bounded table of proof numbers shared by every thread of a proof-number search, keyed by canonical position and
+    // attacker. Entries are two words, the second holding the first xor the key and the work behind the entry, so a torn
+    // write fails the key check. Buckets hold two entries and a new position replaces the one with less work behind it.
+    // A disproof that rests on repetitions of a few positions of the path above it is stored with those positions and
+    // only found again while all of them are on the path, since repeating them still refutes every win and further
+    // repetitions only help the defender. Other entries hold whatever the path
+    class ProofTable {
+    public:
+        static constexpr uint32_t infinity = (1 << 27) - 1;
+
+        ProofTable(size_t size = 1 << 16) {
+            bucket_count = capacity_for(size) / 2;
+            entries.reset(new Entry[bucket_count * 2]);
+        }
+
+        // Entries a table asked for size entries has, a power of two so the bucket is a mask
+        static inline size_t capacity_for(size_t size) {
+            size_t ret = 2;
+            while (ret < size) ret <<= 1;
+            return ret;
+        }
+
+        template <typename RulesT>
+        static inline uint32_t make_key(StateIndex state, PlayerID to_move, PlayerID attacker) {
+            return (uint32_t) rules_move_table<RulesT>.canonical[state].state << 2 | to_move << 1 | attacker;
+        }
+
+        // Leaves ret alone if the table has nothing for key, or only a disproof resting on positions the search context is
+        // not on. The context sits at the parent of position, the one probed
+        template <typename RulesT>
+        bool probe(uint32_t key, ProofNumbers& ret, PositionKey position, const BasicSearchContext<RulesT>& ctx) const {
+            const Entry* bucket = &entries[index(key)];
+            for (unsigned int i = 0; i < 2; i++) {
+                uint64_t data = bucket[i].data.load(std::memory_order_relaxed);
+                uint64_t check = bucket[i].check.load(std::memory_order_relaxed);
+                if ((data ^ check) >> 32 != (uint64_t) key + 1) {
+                    continue;
+                } else if ((data ^ check) & dependent) {
+                    // Symmetric positions share the key but not the positions their disproofs rest on
+                    if ((data >> 48 & 0xFFF) != position) {
+                        return false;
+                    }
+                    ret.repeated_count = data >> 60;
+                    ret.dependency = UINT16_MAX;
+                    for (uint8_t j = 0; j < ret.repeated_count; j++) {
+                        ret.repeated[j] = data >> (j * 12) & 0xFFF;
+                        if (!ctx.occurrences[ret.repeated[j]]) {
+                            return false;
+                        }
+                        ret.dependency = std::min(ret.dependency, ctx.first_seen[ret.repeated[j]]);
+                    }
+                    ret.pn = infinity;
+                    ret.dn = 0;
+                    ret.distance = 0;
+                    return true;
+                }
+
+                ret.pn = data >> 37;
+                ret.dn = data >> 10 & infinity;
+                ret.distance = data & 0x3FF;
+                ret.dependency = UINT16_MAX;
+                ret.repeated_count = 0;
+                return true;
+            }
+            return false;
+        }
+
+        void store(uint32_t key, const ProofNumbers& numbers, uint64_t work) {
+            uint64_t data = (uint64_t) std::min(numbers.pn, infinity) << 37 | (uint64_t) std::min(numbers.dn, infinity) << 10 | std::min<uint16_t>(numbers.distance, 0x3FF);
+            write(key, data, work, false);
+        }
+
+        // Stores the disproof of position resting on repetitions of the positions numbers lists
+        void store_dependent(uint32_t key, const ProofNumbers& numbers, PositionKey position, uint64_t work) {
+            uint64_t data = (uint64_t) numbers.repeated_count << 60 | (uint64_t) position << 48;
+            for (uint8_t i = 0; i < numbers.repeated_count; i++) {
+                data |= (uint64_t) numbers.repeated[i] << (i * 12);
+            }
+            write(key, data, work, true);
+        }
+
+        void clear() {
+            for (size_t i = 0; i < bucket_count * 2; i++) {
+                entries[i].data.store(0, std::memory_order_relaxed);
+                entries[i].check.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        inline size_t capacity() const {
+            return bucket_count * 2;
+        }
+
+    protected:
+        // Proof number (27 bits), disproof number (27) and distance (10), or for a dependent disproof the count (4), the
+        // position disproven (12) and up to four positions it rests on (12 each), then key + 1 (32), the dependent flag
+        // (1) and work (31) xor the first
+        struct Entry {
+            std::atomic<uint64_t> data {0};
+            std::atomic<uint64_t> check {0};
+        };
+
+        static constexpr uint64_t dependent = 1u << 31;
+
+        std::unique_ptr<Entry[]> entries;
+        size_t bucket_count;
+
+        void write(uint32_t key, uint64_t data, uint64_t work, bool is_dependent) {
+            Entry* bucket = &entries[index(key)];
+            uint64_t works[2];
+            for (unsigned int i = 0; i < 2; i++) {
+                uint64_t stored = bucket[i].data.load(std::memory_order_relaxed) ^ bucket[i].check.load(std::memory_order_relaxed);
+                if (stored >> 32 == (uint64_t) key + 1) {
+                    works[0] = works[1] = UINT64_MAX;
+                    works[i] = 0;
+                    break;
+                }
+                works[i] = stored & (dependent - 1);
+            }
+
+            Entry& entry = bucket[works[1] < works[0]];
+            entry.data.store(data, std::memory_order_relaxed);
+            entry.check.store(data ^ ((uint64_t) key + 1) << 32 ^ std::min(work, dependent - 1) ^ (is_dependent ? dependent : 0), std::memory_order_relaxed);
+        }
+
+        inline size_t index(uint32_t key) const {
+            return (key * 0x9E3779B97F4A7C15ull >> 32 & (bucket_count - 1)) * 2;
+        }
+    };
+
+    // Memory a search needs besides the game, kept by the search controller so repeated searches do not reallocate
+    template <typename RulesT>
+    struct BasicSearchBuffers {
+        std::vector<RootMove> root_moves;
+        std::vector<BasicSearchContext<RulesT>> contexts;
+        std::unique_ptr<TranspositionTable> tt; // Lazy SMP table for games without one
+        MCTSTree tree;                          // Monte Carlo tree, kept across the depths of one search
+        std::unique_ptr<ProofTable> proofs;     // Proof-number table, cleared by each search
+
+        // Proof numbers of the root and of each root move for the player to move and for the opponent as attacker, kept
+        // across the depths of a proof-number search since disproofs resting on repetitions are not in the table
+        ProofNumbers proof_root[2];
+        std::vector<ProofNumbers> proof_children[2];
+    };
+
+    typedef BasicSearchBuffers<StandardRules> SearchBuffers;
+
+    enum class SearchMode {
+        RootSplit, // Each root move is searched by its own pool task
+        LazySMP,   // Every pool worker searches the whole tree and shares results through the transposition table
+        MCTS,      // Monte Carlo tree search, pool workers grow one shared UCT tree with 2^depth playouts by each depth
+        ProofNumber // Depth-first proof-number search of whether either side forces a win, spending 2^depth nodes by each depth
+    };
+
+    template <typename RulesT = StandardRules>
+    class BasicGame {
+    public:
+        typedef BasicSuccessors<RulesT> Successors;
+        typedef BasicTablebase<RulesT> Tablebase;
+        typedef BasicSolutionFile<RulesT> SolutionFile;
+        typedef BasicSearchContext<RulesT> SearchContext;
+        typedef BasicSearchBuffers<RulesT> SearchBuffers;
+
+        static constexpr unsigned int state_count = RulesT::state_count;
+        static constexpr unsigned int max_moves = Successors::capacity;
+        static constexpr const BasicMoveTable<RulesT>& move_table = rules_move_table<RulesT>;
+
+        GameState game_state = {{1, 1}, {1, 1}};
+        PlayerID player_id;
+        const Tablebase* tablebase = nullptr; // Consulted before searching when set
+        const SolutionFile* solution = nullptr; // Consulted like the tablebase when set and the tablebase is not
+        TranspositionTable* tt = nullptr;     // Shared by every search worker when set
+        SearchMode search_mode = SearchMode::RootSplit;
+        unsigned int repetition_limit = 2;    // Occurrences on the search path that make a position a draw, 0 disables and 1 draws every position below the root
+        SearchStats* stats = nullptr;         // Receives the statistics of each search when set
+        uint64_t node_budget = 0;             // Deepening stops after the depth that reaches this many nodes, 0 disables
+        size_t multi_pv = 1;                  // Root moves that get an exact score, the others only have to be proven worse
+        bool symmetry_reduction = false;      // Searches one move per distinct position, positions differing only by swapped hands being the same
+        tp::ThreadPool* pool = nullptr;       // Runs the tasks of each search, default_pool() when unset
+        unsigned int thread_budget = 0;       // Threads one search may keep busy at once counting the one running it, 0 for the whole pool
+        MCTSSettings mcts;                    // Only used by SearchMode::MCTS
+        ProofSettings proof;                  // Only used by SearchMode::ProofNumber
+
+        // Called from the searching thread after every completed depth with the best move so far and the statistics
+        // of the search up to that depth
+        std::function<void(const BestMove&, const SearchStats&)> progress;
+
+        BasicGame(PlayerID player_id) :
+            player_id(player_id) { }
+
+        inline void move(Move move) {
+            RulesT::apply_move(game_state, move);
+        }
+
+        template <typename InsertIt>
+        void find_all_moves(InsertIt ret, PlayerID player_id = PLAYER_NONE) {
+            if (player_id == PLAYER_NONE) {
+                player_id = this->player_id;
+            }
+
+            RulesT::generate_moves(game_state, player_id, ret);
+        }
+
+        // One move for each position find_all_moves leads to, counting positions that only differ by swapped hands once.
+        // Every move is one find_all_moves also returns
+        template <typename InsertIt>
+        void find_distinct_moves(InsertIt ret, PlayerID player_id = PLAYER_NONE) {
+            if (player_id == PLAYER_NONE) {
+                player_id = this->player_id;
+            }
+
+            const Successors& successors = move_table.distinct[RulesT::pack_state(game_state)][player_id];
+            std::copy(successors.moves, successors.moves + successors.size, ret);
+        }
+
+        inline tp::ThreadPool& search_pool() const {
+            return pool ? *pool : default_pool();
+        }
+
+        // Threads a search keeps busy at once, the thread budget capped by the size of the pool
+        inline unsigned int search_threads() const {
+            unsigned int size = search_pool().size();
+            return thread_budget ? std::min(thread_budget, size) : size;
+        }
+
+        // The moves the search considers from state
+        inline const Successors& successors_of(StateIndex state, PlayerID player_id) const {
+            return symmetry_reduction ? move_table.distinct[state][player_id] : move_table.successors[state][player_id];
+        }
+
+        // Counts the move sequences of the given length from the current state using only find_all_moves and move,
+        // games that end sooner are not counted
+        uint64_t perft(unsigned int depth, PlayerID player_id = PLAYER_NONE) {
+            if (player_id == PLAYER_NONE) {
+                player_id = this->player_id;
+            }
+
+            if (depth == 0) {
+                return 1;
+            }
+
+            boost::container::static_vector<Move, max_moves> moves;
+            find_all_moves(std::back_inserter(moves), player_id);
+            if (depth == 1) {
+                return moves.size();
+            }
+
+            Player saved[2] = {game_state[PLAYER_A], game_state[PLAYER_B]};
+            uint64_t ret = 0;
+            for (const Move& move : moves) {
+                this->move(move);
+                ret += perft(depth - 1, opposite_player(player_id));
+                game_state[PLAYER_A] = saved[PLAYER_A];
+                game_state[PLAYER_B] = saved[PLAYER_B];
+            }
+            return ret;
+        }
+
+        // Perft count below each root move, the parallel version runs a pool task for every reply to every root move
+        std::vector<std::pair<Move, uint64_t>> perft_divide(unsigned int depth, bool parallel = false, PlayerID player_id = PLAYER_NONE) {
+            if (player_id == PLAYER_NONE) {
+                player_id = this->player_id;
+            }
+
+            std::vector<std::pair<Move, uint64_t>> ret;
+            if (depth == 0) {
+                return ret;
+            }
+
+            boost::container::static_vector<Move, max_moves> moves;
+            find_all_moves(std::back_inserter(moves), player_id);
+            for (const Move& move : moves) {
+                ret.emplace_back(move, 0);
+            }
+
+            if (!parallel || depth == 1) {
+                for (auto& [move, count] : ret) {
+                    BasicGame child = *this;
+                    child.move(move);
+                    count = child.perft(depth - 1, opposite_player(player_id));
+                }
+                return ret;
+            }
+
+            tp::TaskGroup group(search_pool());
+            boost::container::static_vector<std::pair<size_t, tp::Future<uint64_t>>, max_moves * max_moves> counts;
+            for (size_t i = 0; i < ret.size(); i++) {
+                GameState state = {game_state[PLAYER_A], game_state[PLAYER_B]};
+                RulesT::apply_move(state, ret[i].first);
+
+                boost::container::static_vector<Move, max_moves> replies;
+                RulesT::generate_moves(state, opposite_player(player_id), std::back_inserter(replies));
+                for (const Move& reply : replies) {
+                    counts.emplace_back(i, group.run([state = RulesT::pack_state(state), reply, depth, player_id]() {
+                        BasicGame child(player_id);
+                        RulesT::unpack_state(state, child.game_state);
+                        child.move(reply);
+                        return child.perft(depth - 2, player_id);
+                    }));
+                }
+            }
+            group.wait();
+
+            for (auto& [i, count] : counts) {
+                ret[i].second += count.get();
+            }
+            return ret;
+        }
+
+        static inline int evaluate(StateIndex state, PlayerID player_id) {
+            return RulesT::evaluate(state, player_id);
+        }
+
+        // Scores a leaf ply plies from the root, a decided position scores by its distance
+        static inline int evaluate(StateIndex state, PlayerID player_id, unsigned int ply) {
+            return evaluate(state, player_id) * (score_win - (int) ply);
+        }
+
+        inline int evaluate(PlayerID player_id = PLAYER_NONE) {
+            if (player_id == PLAYER_NONE) {
+                player_id = this->player_id;
+            }
+
+            return evaluate(RulesT::pack_state(game_state), player_id);
+        }
+
+        // Searches the position reached by a move from the current game state, player_id is to move
+        int maxi(Move move, int alpha, int beta, unsigned int depth, const std::atomic<bool>& stop_flag, PlayerID player_id = PLAYER_NONE) {
+            if (player_id == PLAYER_NONE) {
+                player_id = this->player_id;
+            }
+
+            SearchContext ctx(stop_flag, player_id);
+            ctx.push(position_key(RulesT::pack_state(game_state), opposite_player(player_id)));
+
+            GameState new_game_state = {game_state[PLAYER_A], game_state[PLAYER_B]};
+            RulesT::apply_move(new_game_state, move);
+            return maxi(RulesT::pack_state(new_game_state), alpha, beta, depth, ctx);
+        }
+
+        // Searches the position reached by a move from the current game state, the opponent of player_id is to move
+        int mini(Move move, int alpha, int beta, unsigned int depth, const std::atomic<bool>& stop_flag, PlayerID player_id = PLAYER_NONE) {
+            if (player_id == PLAYER_NONE) {
+                player_id = this->player_id;
+            }
+
+            SearchContext ctx(stop_flag, player_id);
+            ctx.push(position_key(RulesT::pack_state(game_state), player_id));
+
+            GameState new_game_state = {game_state[PLAYER_A], game_state[PLAYER_B]};
+            RulesT::apply_move(new_game_state, move);
+            return mini(RulesT::pack_state(new_game_state), alpha, beta, depth, ctx);
+        }
+
+        // What a score found with repetitions of positions above this one scoring draws still says about the position
+        // wherever it is reached from. A side whose score is above a draw never let the other side reach those draws
+        // along its best lines, and taking them away can only add options to its own moves, so a positive lower bound
+        // and a negative upper bound stand. Anything else is stored marked as path dependent: it still cuts off searches
+        // and orders moves elsewhere, but like a repetition it makes every position above it path dependent in turn, so
+        // no decided score ever rests on it
+        static inline TranspositionTable::Bound path_independent_bound(TranspositionTable::Bound bound, int score) {
+            if (score > 0 && bound != TranspositionTable::BOUND_UPPER) {
+                return TranspositionTable::BOUND_LOWER;
+            } else if (score < 0 && bound != TranspositionTable::BOUND_LOWER) {
+                return TranspositionTable::BOUND_UPPER;
+            }
+            return TranspositionTable::BOUND_NONE;
+        }
+
+        int maxi(StateIndex state, int alpha, int beta, unsigned int depth, SearchContext& ctx) {
+            unsigned int ply = ctx.path.size();
+            if (depth == 0) {
+                ctx.stats.leaves++;
+                return evaluate(state, ctx.player_id, ply);
+            }
+            ctx.stats.nodes++;
+
+            PositionKey position = position_key(state, ctx.player_id);
+            if (repetition_limit && ctx.occurrences[position] + 1 >= (int) repetition_limit) {
+                ctx.repetition_ply = std::min(ctx.repetition_ply, ctx.first_seen[position]);
+                return std::max(alpha, std::min(0, beta));
+            }
+
+            const Successors& successors = successors_of(state, ctx.player_id);
+
+            TranspositionTable::Key key;
+            TranspositionTable::Entry entry;
+            const Move* tt_move = nullptr;
+            if (tt) {
+                key = TranspositionTable::make_key<RulesT>(state, ctx.player_id);
+                ctx.stats.tt_probes++;
+                if (tt->probe(key, entry, ctx.player_id, ply)) {
+                    ctx.stats.tt_hits++;
+                    if (entry.depth >= depth &&
+                        (entry.bound == TranspositionTable::BOUND_EXACT ||
+                            (entry.bound == TranspositionTable::BOUND_LOWER && entry.score >= beta) ||
+                            (entry.bound == TranspositionTable::BOUND_UPPER && entry.score <= alpha))) {
+                        if (entry.path_dependent) {
+                            ctx.repetition_ply = 0; // Whatever this decides holds only along the current path too
+                        }
+                        return std::max(alpha, std::min(entry.score, beta));
+                    } else if (entry.has_best_move) {
+                        tt_move = &entry.best_move;
+                    }
+                }
+            }
+
+            if (successors.size == 0) {
+                int score = evaluate(state, ctx.player_id, ply); // Only a finished game has no moves
+                if (tt) tt->store(key, score, UINT_MAX, TranspositionTable::BOUND_EXACT, nullptr, ctx.player_id, ply);
+                return score;
+            }
+
+            uint8_t order[max_moves];
+            ctx.order(successors, order, tt_move, ctx.player_id);
+
+            ctx.push(position);
+            uint16_t outer_repetition_ply = ctx.repetition_ply;
+            ctx.repetition_ply = UINT16_MAX;
+            int old_alpha = alpha;
+            const Move* best_move = nullptr;
+            for (uint8_t i = 0; i < successors.size && alpha < beta; i++) {
+                StateIndex child = successors.children[order[i]];
+
+                int score;
+                if (i == 0) {
+                    score = mini(child, alpha, beta, depth - 1, ctx);
+                } else {
+                    // Principal variation search, later moves only have to prove they are no better
+                    score = mini(child, alpha, alpha + 1, depth - 1, ctx);
+                    if (score > alpha && score < beta && !ctx.stopped()) {
+                        score = mini(child, alpha, beta, depth - 1, ctx);
+                    }
+                }
+
+                if (ctx.stopped()) {
+                    ctx.pop();
+                    ctx.repetition_ply = std::min(outer_repetition_ply, ctx.repetition_ply);
+                    return alpha;
+                } else if (score > alpha) {
+                    alpha = std::min(score, beta);
+                    best_move = &successors.moves[order[i]];
+                    if (alpha >= beta) {
+                        ctx.stats.cutoffs++;
+                        ctx.stats.first_move_cutoffs += i == 0;
+                        ctx.reward(*best_move, ctx.player_id, depth);
+                    }
+                }
+            }
+            ctx.pop();
+
+            TranspositionTable::Bound bound = alpha >= beta ? TranspositionTable::BOUND_LOWER : (alpha > old_alpha ? TranspositionTable::BOUND_EXACT : TranspositionTable::BOUND_UPPER);
+            bool path_dependent = false;
+            if (ctx.repetition_ply < ply) {
+                TranspositionTable::Bound independent = path_independent_bound(bound, alpha);
+                path_dependent = independent == TranspositionTable::BOUND_NONE;
+                if (!path_dependent) bound = independent;
+            }
+            ctx.repetition_ply = std::min(outer_repetition_ply, ctx.repetition_ply);
+            if (tt) tt->store(key, alpha, depth, bound, best_move, ctx.player_id, ply, path_dependent);
+            return alpha;
+        }
+
+        int mini(StateIndex state, int alpha, int beta, unsigned int depth, SearchContext& ctx) {
+            unsigned int ply = ctx.path.size();
+            if (depth == 0) {
+                ctx.stats.leaves++;
+                return evaluate(state, ctx.player_id, ply);
+            }
+            ctx.stats.nodes++;
+
+            PlayerID opponent = opposite_player(ctx.player_id);
+            PositionKey position = position_key(state, opponent);
+            if (repetition_limit && ctx.occurrences[position] + 1 >= (int) repetition_limit) {
+                ctx.repetition_ply = std::min(ctx.repetition_ply, ctx.first_seen[position]);
+                return std::max(alpha, std::min(0, beta));
+            }
+
+            const Successors& successors = successors_of(state, opponent);
+
+            TranspositionTable::Key key;
+            TranspositionTable::Entry entry;
+            const Move* tt_move = nullptr;
+            if (tt) {
+                key = TranspositionTable::make_key<RulesT>(state, opponent);
+                ctx.stats.tt_probes++;
+                if (tt->probe(key, entry, ctx.player_id, ply)) {
+                    ctx.stats.tt_hits++;
+                    if (entry.depth >= depth &&
+                        (entry.bound == TranspositionTable::BOUND_EXACT ||
+                            (entry.bound == TranspositionTable::BOUND_LOWER && entry.score >= beta) ||
+                            (entry.bound == TranspositionTable::BOUND_UPPER && entry.score <= alpha))) {
+                        if (entry.path_dependent) {
+                            ctx.repetition_ply = 0; // Whatever this decides holds only along the current path too
+                        }
+                        return std::max(alpha, std::min(entry.score, beta));
+                    } else if (entry.has_best_move) {
+                        tt_move = &entry.best_move;
+                    }
+                }
+            }
+
+            if (successors.size == 0) {
+                int score = evaluate(state, ctx.player_id, ply); // Only a finished game has no moves
+                if (tt) tt->store(key, score, UINT_MAX, TranspositionTable::BOUND_EXACT, nullptr, ctx.player_id, ply);
+                return score;
+            }
+
+            uint8_t order[max_moves];
+            ctx.order(successors, order, tt_move, opponent);
+
+            ctx.push(position);
+            uint16_t outer_repetition_ply = ctx.repetition_ply;
+            ctx.repetition_ply = UINT16_MAX;
+            int old_beta = beta;
+            const Move* best_move = nullptr;
+            for (uint8_t i = 0; i < successors.size && alpha < beta; i++) {
+                StateIndex child = successors.children[order[i]];
+
+                int score;
+                if (i == 0) {
+                    score = maxi(child, alpha, beta, depth - 1, ctx);
+                } else {
+                    score = maxi(child, beta - 1, beta, depth - 1, ctx);
+                    if (score < beta && score > alpha && !ctx.stopped()) {
+                        score = maxi(child, alpha, beta, depth - 1, ctx);
+                    }
+                }
+
+                if (ctx.stopped()) {
+                    ctx.pop();
+                    ctx.repetition_ply = std::min(outer_repetition_ply, ctx.repetition_ply);
+                    return beta;
+                } else if (score < beta) {
+                    beta = std::max(score, alpha);
+                    best_move = &successors.moves[order[i]];
+                    if (beta <= alpha) {
+                        ctx.stats.cutoffs++;
+                        ctx.stats.first_move_cutoffs += i == 0;
+                        ctx.reward(*best_move, opponent, depth);
+                    }
+                }
+            }
+            ctx.pop();
+
+            TranspositionTable::Bound bound = beta <= alpha ? TranspositionTable::BOUND_UPPER : (beta < old_beta ? TranspositionTable::BOUND_EXACT : TranspositionTable::BOUND_LOWER);
+            bool path_dependent = false;
+            if (ctx.repetition_ply < ply) {
+                TranspositionTable::Bound independent = path_independent_bound(bound, beta);
+                path_dependent = independent == TranspositionTable::BOUND_NONE;
+                if (!path_dependent) bound = independent;
+            }
+            ctx.repetition_ply = std::min(outer_repetition_ply, ctx.repetition_ply);
+            if (tt) tt->store(key, beta, depth, bound, best_move, ctx.player_id, ply, path_dependent);
+            return beta;
+        }
+
+        // Searches every root move to the given depth, storing their scores, and returns the index of the best one. The
+        // first multi_pv moves get a full window, later moves a null window at the worst exact score so far and a full
+        // one if they beat it
+        size_t search_root(std::vector<RootMove>& root_moves, std::vector<SearchContext>& contexts, unsigned int depth, const std::atomic<bool>& stop_flag, std::atomic<bool>& helpers_stop, tp::TaskGroup& group, std::vector<std::atomic<uint64_t>>& worker_nodes) {
+            size_t exact_count = std::min(std::max<size_t>(multi_pv, 1), root_moves.size());
+            for (RootMove& root_move : root_moves) {
+                root_move.exact = false;
+            }
+
+            // The window later moves are searched against, the multi_pv-th best exact score
+            auto threshold = [&root_moves, exact_count](size_t searched) {
+                boost::container::static_vector<int, max_moves> scores;
+                for (size_t i = 0; i < searched; i++) {
+                    if (root_moves[i].exact) {
+                        scores.push_back(root_moves[i].score);
+                    }
+                }
+                std::nth_element(scores.begin(), scores.begin() + (exact_count - 1), scores.end(), std::greater<int>());
+                return scores[exact_count - 1];
+            };
+
+            // The first move sets the window the others are searched against
+            RootMove& first = root_moves[0];
+            SearchContext& main_ctx = contexts[search_mode == SearchMode::RootSplit ? first.context : 0];
+            {
+                detail::WorkerCredit credit(main_ctx.stats, worker_nodes, search_pool());
+                first.score = mini(first.state, -score_infinity, score_infinity, depth - 1, main_ctx);
+                first.exact = true;
+            }
+            if (stop_flag) {
+                return 0;
+            }
+
+            switch (search_mode) {
+                case SearchMode::RootSplit: {
+                    // No more tasks than the search may keep threads busy, each taking the next unsearched move
+                    auto search = [this, &root_moves, &contexts, &worker_nodes, &group, depth](size_t begin, size_t end, int alpha) {
+                        std::atomic<size_t> next(begin);
+                        for (size_t task = begin; task < end && task - begin < search_threads(); task++) {
+                            group.run([this, &root_moves, &contexts, &worker_nodes, &next, end, alpha, depth]() {
+                                for (size_t i = next++; i < end; i = next++) {
+                                    RootMove& root_move = root_moves[i];
+                                    SearchContext& ctx = contexts[root_move.context];
+                                    detail::WorkerCredit credit(ctx.stats, worker_nodes, search_pool());
+                                    if (alpha == -score_infinity) {
+                                        root_move.score = mini(root_move.state, alpha, score_infinity, depth - 1, ctx);
+                                    } else {
+                                        root_move.score = mini(root_move.state, alpha, alpha + 1, depth - 1, ctx);
+                                        if (root_move.score > alpha && !ctx.stopped()) {
+                                            root_move.score = mini(root_move.state, alpha, score_infinity, depth - 1, ctx);
+                                        }
+                                    }
+                                    root_move.exact = alpha == -score_infinity || root_move.score > alpha;
+                                }
+                            });
+                        }
+                        group.wait();
+                    };
+
+                    search(1, exact_count, -score_infinity);
+                    if (!stop_flag) {
+                        search(exact_count, root_moves.size(), threshold(exact_count));
+                    }
+                    break;
+                }
+
+                case SearchMode::LazySMP: {
+                    // Helpers start at different root moves and alternate between this depth and the next, so they
+                    // fill the shared table with results the main search is about to need
+                    helpers_stop = false;
+                    for (unsigned int i = 1; i < search_threads() && i < contexts.size(); i++) {
+                        group.run([this, &root_moves, &ctx = contexts[i], &worker_nodes, depth, i]() {
+                            detail::WorkerCredit credit(ctx.stats, worker_nodes, search_pool());
+                            for (size_t j = 0; j < root_moves.size() && !ctx.stopped(); j++) {
+                                mini(root_moves[(i + j) % root_moves.size()].state, -score_infinity, score_infinity, depth - 1 + i % 2, ctx);
+                            }
+                        });
+                    }
+
+                    detail::WorkerCredit credit(main_ctx.stats, worker_nodes, search_pool());
+                    for (size_t i = 1; i < root_moves.size(); i++) {
+                        int alpha = i < exact_count ? -score_infinity : threshold(i);
+                        int score;
+                        if (alpha == -score_infinity) {
+                            score = mini(root_moves[i].state, alpha, score_infinity, depth - 1, main_ctx);
+                        } else {
+                            score = mini(root_moves[i].state, alpha, alpha + 1, depth - 1, main_ctx);
+                            if (score > alpha && !stop_flag) {
+                                score = mini(root_moves[i].state, alpha, score_infinity, depth - 1, main_ctx);
+                            }
+                        }
+
+                        if (stop_flag) {
+                            break;
+                        }
+                        root_moves[i].score = score;
+                        root_moves[i].exact = alpha == -score_infinity || score > alpha;
+                    }
+
+                    helpers_stop = true;
+                    group.wait();
+                    break;
+                }
+                case SearchMode::MCTS:
+                case SearchMode::ProofNumber:
+                    break; // Searched by deepen without a root split
+            }
+
+            size_t ret = 0;
+            for (size_t i = 1; i < root_moves.size(); i++) {
+                if (root_moves[i].score > root_moves[ret].score) {
+                    ret = i;
+                }
+            }
+            return ret;
+        }
+
+        // Runs Monte Carlo playouts on every thread the search may use until the tree has had 2^depth of them, then scores
+        // each root move by the share of its playouts won and returns the index of the most visited one, or of a move
+        // that wins at once. The context of a root move is the index of its node among the root's children
+        size_t search_tree(MCTSTree& tree, std::vector<RootMove>& root_moves, std::vector<SearchContext>& contexts, unsigned int depth, tp::TaskGroup& group, std::vector<std::atomic<uint64_t>>& worker_nodes) {
+            uint64_t target = depth < 64 ? (uint64_t) 1 << depth : UINT64_MAX;
+            auto work = [this, &tree, &worker_nodes, target, depth](SearchContext& ctx, unsigned int worker) {
+                detail::WorkerCredit credit(ctx.stats, worker_nodes, search_pool());
+                std::minstd_rand rng((uint32_t) (mcts.seed + ((uint64_t) depth << 16) + worker));
+                while (!ctx.stopped() && tree.nodes[0].visits.load(std::memory_order_relaxed) < target) {
+                    simulate(tree, ctx, rng);
+                }
+            };
+
+            unsigned int threads = std::min<size_t>(search_threads(), contexts.size());
+            for (unsigned int i = 1; i < threads; i++) {
+                group.run([&work, &ctx = contexts[i], i]() {
+                    work(ctx, i);
+                });
+            }
+            work(contexts[0], 0);
+            group.wait();
+
+            // Scores stay clear of the decided range, except for moves that win at once
+            constexpr int scale = score_win - (int) max_ply - 1;
+            PlayerID player_id = contexts[0].player_id;
+            const MCTSNode& root = tree.nodes[0];
+            size_t ret = 0;
+            uint64_t best_visits = 0;
+            for (size_t i = 0; i < root_moves.size(); i++) {
+                RootMove& root_move = root_moves[i];
+                const MCTSNode& child = tree.nodes[root.first_child + root_move.context];
+                uint64_t visits = child.visits.load(std::memory_order_relaxed);
+                if (evaluate(root_move.state, player_id) > 0) {
+                    root_move.score = evaluate(root_move.state, player_id, 1);
+                    visits = UINT64_MAX;
+                } else if (visits) {
+                    double share = child.reward.load(std::memory_order_relaxed) / (2. * visits);
+                    root_move.score = (int) std::lround((2. * share - 1.) * scale);
+                } else {
+                    root_move.score = -scale;
+                }
+                root_move.exact = visits != 0;
+
+                if (visits > best_visits) {
+                    best_visits = visits;
+                    ret = i;
+                }
+            }
+            return ret;
+        }
+
+        // One Monte Carlo iteration: walks down the tree by UCT, expands the leaf it reaches, plays out from one of the new
+        // children and credits the result to every node on the way. Nodes count a visit as soon as they are selected, so
+        // workers sharing the tree spread out over different paths
+        void simulate(MCTSTree& tree, SearchContext& ctx, std::minstd_rand& rng) {
+            boost::container::static_vector<uint32_t, max_ply + 1> selected {0};
+            size_t base = ctx.path.size();
+            PlayerID to_move = ctx.player_id;
+            tree.nodes[0].visits.fetch_add(1, std::memory_order_relaxed);
+
+            int result; // From the perspective of ctx.player_id
+            for (;;) {
+                MCTSNode& node = tree.nodes[selected.back()];
+                ctx.stats.nodes++;
+                if (evaluate(node.state, to_move) != 0) {
+                    result = evaluate(node.state, ctx.player_id);
+                    break;
+                }
+
+                bool expanded = false;
+                if (node.expansion.load(std::memory_order_acquire) != MCTSNode::EXPANDED) {
+                    if (!expand(tree, node, to_move)) {
+                        result = playout(node.state, to_move, ctx, rng);
+                        break;
+                    }
+                    expanded = true;
+                }
+
+                uint32_t index = select(tree, node);
+                MCTSNode& child = tree.nodes[index];
+                child.visits.fetch_add(1, std::memory_order_relaxed);
+                selected.push_back(index);
+                to_move = opposite_player(to_move);
+
+                PositionKey position = position_key(child.state, to_move);
+                if ((repetition_limit && ctx.occurrences[position] + 1 >= (int) repetition_limit) || ctx.path.size() >= max_ply) {
+                    result = 0;
+                    break;
+                }
+                ctx.push(position);
+                if (expanded) {
+                    result = playout(child.state, to_move, ctx, rng);
+                    break;
+                }
+            }
+            ctx.stats.leaves++;
+
+            // The root's children were moved into by ctx.player_id, and turns alternate below them
+            for (size_t i = 0; i < selected.size(); i++) {
+                int outcome = i % 2 ? result : -result;
+                tree.nodes[selected[i]].reward.fetch_add(outcome + 1, std::memory_order_relaxed);
+            }
+            while (ctx.path.size() > base) {
+                ctx.pop();
+            }
+        }
+
+        // Gives node its children unless another worker is already doing so or the arena is full, returns true if the node
+        // has children afterwards
+        bool expand(MCTSTree& tree, MCTSNode& node, PlayerID to_move) {
+            uint8_t expected = MCTSNode::LEAF;
+            if (!node.expansion.compare_exchange_strong(expected, MCTSNode::EXPANDING, std::memory_order_acquire)) {
+                return expected == MCTSNode::EXPANDED;
+            }
+
+            const Successors& successors = successors_of(node.state, to_move);
+            uint32_t first;
+            if (successors.size == 0 || !tree.allocate(successors.size, first)) {
+                return false; // Stays a leaf
+            }
+            for (uint8_t i = 0; i < successors.size; i++) {
+                MCTSTree::clear(tree.nodes[first + i], successors.children[i]);
+            }
+            node.first_child = first;
+            node.child_count = successors.size;
+            node.expansion.store(MCTSNode::EXPANDED, std::memory_order_release);
+            return true;
+        }
+
+        // The child with the highest upper confidence bound, children that have not been visited come first
+        uint32_t select(const MCTSTree& tree, const MCTSNode& node) const {
+            double log_visits = std::log((double) node.visits.load(std::memory_order_relaxed));
+            uint32_t ret = node.first_child;
+            double best = -1.;
+            for (uint32_t i = node.first_child; i < node.first_child + node.child_count; i++) {
+                const MCTSNode& child = tree.nodes[i];
+                uint64_t visits = child.visits.load(std::memory_order_relaxed);
+                if (visits == 0) {
+                    return i;
+                }
+
+                double value = child.reward.load(std::memory_order_relaxed) / (2. * visits) + mcts.exploration * std::sqrt(log_visits / visits);
+                if (value > best) {
+                    best = value;
+                    ret = i;
+                }
+            }
+            return ret;
+        }
+
+        // Plays moves chosen by the playout policy from state until the game ends, a position repeats or the playout limit
+        // is reached, returns the result from the perspective of ctx.player_id. Pushes every position it reaches to ctx
+        int playout(StateIndex state, PlayerID to_move, SearchContext& ctx, std::minstd_rand& rng) {
+            for (unsigned int ply = 0;; ply++) {
+                const Successors& successors = successors_of(state, to_move);
+                if (evaluate(state, to_move) != 0 || successors.size == 0) {
+                    return evaluate(state, ctx.player_id);
+                } else if (ply >= mcts.playout_limit || ctx.path.size() >= max_ply) {
+                    return 0;
+                }
+
+                state = successors.children[playout_move(successors, to_move, rng)];
+                to_move = opposite_player(to_move);
+                PositionKey position = position_key(state, to_move);
+                if (repetition_limit && ctx.occurrences[position] + 1 >= (int) repetition_limit) {
+                    return 0;
+                }
+                ctx.push(position);
+                ctx.stats.nodes++;
+            }
+        }
+
+        // Index of the successor the playout policy picks for to_move
+        uint8_t playout_move(const Successors& successors, PlayerID to_move, std::minstd_rand& rng) const {
+            if (mcts.playout_policy != PlayoutPolicy::Random) {
+                for (uint8_t i = 0; i < successors.size; i++) {
+                    if (evaluate(successors.children[i], to_move) > 0) {
+                        return i;
+                    }
+                }
+            }
+
+            if (mcts.playout_policy == PlayoutPolicy::AntiDecisive) {
+                PlayerID opponent = opposite_player(to_move);
+                uint8_t safe[max_moves];
+                uint8_t safe_count = 0;
+                for (uint8_t i = 0; i < successors.size; i++) {
+                    const Successors& replies = successors_of(successors.children[i], opponent);
+                    bool losing = false;
+                    for (uint8_t j = 0; j < replies.size && !losing; j++) {
+                        losing = evaluate(replies.children[j], opponent) > 0;
+                    }
+                    if (!losing) {
+                        safe[safe_count++] = i;
+                    }
+                }
+                if (safe_count) {
+                    return safe[rng() % safe_count];
+                }
+            }
+            return rng() % successors.size;
+        }
+
+        // One thread's part in a proof-number search
+        struct ProofWorker {
+            ProofTable& table;
+            PlayerID attacker;
+            uint64_t node_limit;           // Of ctx.stats.nodes
+            const std::atomic<bool>& done; // Raised when another thread has finished the search
+            double epsilon;
+            unsigned int rotation;         // Children tied on proof numbers are taken from this index on
+        };
+
+        // Spends 2^depth nodes in total on a depth-first proof-number search of whether the player to move forces a win,
+        // then of whether the opponent does once the first is disproven. Helper threads search the same root with growing
+        // threshold slack and share results through the table. Sets settled once the root is a proven win, loss or draw,
+        // scores the root moves with what is known of them and returns the index of the best one
+        size_t search_proof(SearchBuffers& buffers, std::vector<SearchContext>& contexts, unsigned int depth, tp::TaskGroup& group, std::vector<std::atomic<uint64_t>>& worker_nodes, bool& settled) {
+            std::vector<RootMove>& root_moves = buffers.root_moves;
+            SearchContext& main_ctx = contexts[0];
+            PlayerID player_id = main_ctx.player_id;
+            StateIndex root = RulesT::pack_state(game_state);
+            uint64_t node_limit = depth < 64 ? (uint64_t) 1 << depth : UINT64_MAX;
+
+            for (unsigned int phase = 0; phase < 2 && main_ctx.stats.nodes < node_limit && !main_ctx.stopped(); phase++) {
+                ProofNumbers& numbers = buffers.proof_root[phase];
+                if (numbers.pn == 0 && phase == 0) {
+                    break;
+                } else if (numbers.pn == 0 || numbers.dn == 0) {
+                    continue;
+                }
+
+                PlayerID attacker = phase == 0 ? player_id : opposite_player(player_id);
+                std::atomic<bool> done(false);
+                unsigned int threads = std::min<size_t>(search_threads(), contexts.size());
+                for (unsigned int i = 1; i < threads; i++) {
+                    group.run([this, &buffers, &ctx = contexts[i], &worker_nodes, &done, root, attacker, i]() {
+                        detail::WorkerCredit credit(ctx.stats, worker_nodes, search_pool());
+                        ProofWorker worker {*buffers.proofs, attacker, UINT64_MAX, done, proof.epsilon * (i + 1), i};
+                        prove(root, ctx.player_id, ProofTable::infinity, ProofTable::infinity, worker, ctx);
+                    });
+                }
+                {
+                    detail::WorkerCredit credit(main_ctx.stats, worker_nodes, search_pool());
+                    ProofWorker worker {*buffers.proofs, attacker, node_limit, done, proof.epsilon, 0};
+                    numbers = prove(root, player_id, ProofTable::infinity, ProofTable::infinity, worker, main_ctx, buffers.proof_children[phase].data());
+                }
+                done = true;
+                group.wait();
+
+                if (numbers.pn == 0 && phase == 0) {
+                    break;
+                }
+            }
+
+            // Scores of proven root moves count their distance from the root, moves that are not proven score 0
+            const ProofNumbers& win = buffers.proof_root[0];
+            const ProofNumbers& loss = buffers.proof_root[1];
+            settled = win.pn == 0 || loss.pn == 0 || loss.dn == 0;
+            size_t ret = 0;
+            for (size_t i = 0; i < root_moves.size(); i++) {
+                RootMove& root_move = root_moves[i];
+                const ProofNumbers& attack = buffers.proof_children[0][root_move.context];
+                const ProofNumbers& defence = buffers.proof_children[1][root_move.context];
+                if (attack.pn == 0) {
+                    root_move.score = score_win - (int) attack.distance - 1;
+                } else if (defence.pn == 0) {
+                    root_move.score = -(score_win - (int) defence.distance - 1);
+                } else {
+                    root_move.score = 0;
+                }
+                root_move.exact = attack.pn == 0 || defence.pn == 0 || (win.dn == 0 && defence.dn == 0);
+
+                // Once settled, a proven draw beats a move that is merely not proven to lose. Before that the move closest
+                // to a winning proof comes first
+                const RootMove& best = root_moves[ret];
+                const ProofNumbers& best_attack = buffers.proof_children[0][best.context];
+                if (root_move.score > best.score || (root_move.score == best.score && (settled ? root_move.exact && !best.exact : attack.pn < best_attack.pn))) {
+                    ret = i;
+                }
+            }
+            return ret;
+        }
+
+        // Depth-first proof-number search of state with to_move to play, the last position of the ctx path, returning once
+        // its proof or disproof number reaches its threshold, the worker's node limit is spent or the search stops.
+        // Repeated positions disprove a win, and disproofs resting on repetitions above state are stored with the positions
+        // they rest on. Copies the numbers of each successor to children when given
+        ProofNumbers prove(StateIndex state, PlayerID to_move, uint32_t pn_threshold, uint32_t dn_threshold, const ProofWorker& worker, SearchContext& ctx, ProofNumbers* children = nullptr) {
+            constexpr uint32_t infinity = ProofTable::infinity;
+            uint64_t start = ctx.stats.nodes++;
+            bool attacking = to_move == worker.attacker;
+            PlayerID next = opposite_player(to_move);
+            const Successors& successors = successors_of(state, to_move);
+            int limit = repetition_limit ? (int) repetition_limit : 2; // Cycles end the search either way
+
+            ProofNumbers local[max_moves];
+            if (!children) {
+                children = local;
+            }
+            for (uint8_t i = 0; i < successors.size; i++) {
+                StateIndex child = successors.children[i];
+                int evaluation = evaluate(child, worker.attacker);
+                ProofNumbers& numbers = children[i];
+                numbers = ProofNumbers();
+                if (evaluation != 0) {
+                    numbers.pn = evaluation > 0 ? 0 : infinity;
+                    numbers.dn = evaluation > 0 ? infinity : 0;
+                } else if (ctx.occurrences[position_key(child, next)] + 1 >= limit) {
+                    numbers.pn = infinity;
+                    numbers.dn = 0;
+                    // Repetitions past the first need more than the position on the path, so only the first is listed
+                    PositionKey position = position_key(child, next);
+                    numbers.dependency = ctx.first_seen[position];
+                    numbers.repeated_count = limit == 2 ? 1 : ProofNumbers::max_repeated + 1;
+                    numbers.repeated[0] = position;
+                } else if (ctx.path.size() >= max_ply) {
+                    numbers.pn = infinity;
+                    numbers.dn = 0;
+                    numbers.dependency = 0;
+                    numbers.repeated_count = ProofNumbers::max_repeated + 1;
+                } else {
+                    ctx.stats.tt_probes++;
+                    ctx.stats.tt_hits += worker.table.probe(ProofTable::make_key<RulesT>(child, next, worker.attacker), numbers, position_key(child, next), ctx);
+                }
+            }
+
+            ProofNumbers ret;
+            for (;;) {
+                // The attacker needs one child proven and all disproven to fail, the defender the other way around
+                uint64_t open = 0;
+                uint32_t largest = 0;
+                uint32_t best_value = infinity + 1;
+                uint32_t second_value = infinity + 1;
+                uint8_t best = 0;
+                for (uint8_t k = 0; k < successors.size; k++) {
+                    uint8_t i = (k + worker.rotation) % successors.size;
+                    uint32_t value = attacking ? children[i].pn : children[i].dn;
+                    uint32_t other = attacking ? children[i].dn : children[i].pn;
+                    open += other != 0;
+                    largest = std::max(largest, other);
+                    if (value < best_value) {
+                        second_value = best_value;
+                        best_value = value;
+                        best = i;
+                    } else if (value < second_value) {
+                        second_value = value;
+                    }
+                }
+                // Transpositions and cycles count the same positions under several children, so rather than their sum the
+                // other number is the largest one plus the other children still open. It stops short of infinity, which
+                // only a proof or disproof may reach
+                uint32_t total = best_value == 0 ? infinity : open == 0 ? 0 : std::min<uint64_t>(largest + open - 1, infinity - 1);
+                ret.pn = attacking ? best_value : total;
+                ret.dn = attacking ? total : best_value;
+                if (successors.size == 0) {
+                    ret.pn = infinity; // Only a finished game has no moves, and the parent evaluates those itself
+                    ret.dn = 0;
+                }
+
+                if (ret.pn == 0 || ret.dn == 0 || ret.pn >= pn_threshold || ret.dn >= dn_threshold ||
+                    ctx.stopped() || worker.done.load(std::memory_order_relaxed) || ctx.stats.nodes >= worker.node_limit) {
+                    break;
+                }
+
+                // The child keeps going until it is no longer the most promising, or its parent's threshold is reached.
+                // The slack lets it run a little past the second best, so the search switches between children less
+                uint64_t slack = (uint64_t) std::ceil(second_value * (1. + worker.epsilon)) + 1;
+                uint32_t child_pn = pn_threshold;
+                uint32_t child_dn = dn_threshold;
+                if (attacking) {
+                    child_pn = std::min<uint64_t>(pn_threshold, slack);
+                    child_dn = std::min<uint64_t>((uint64_t) dn_threshold - ret.dn + children[best].dn, infinity);
+                } else {
+                    child_dn = std::min<uint64_t>(dn_threshold, slack);
+                    child_pn = std::min<uint64_t>((uint64_t) pn_threshold - ret.pn + children[best].pn, infinity);
+                }
+
+                ctx.push(position_key(successors.children[best], next));
+                children[best] = prove(successors.children[best], next, child_pn, child_dn, worker, ctx);
+                ctx.pop();
+            }
+
+            if (ret.pn == 0) {
+                // The quickest proven move for the attacker, the slowest reply for the defender
+                ret.distance = attacking ? UINT16_MAX : 0;
+                for (uint8_t i = 0; i < successors.size; i++) {
+                    if (children[i].pn == 0) {
+                        ret.distance = attacking ? std::min<uint16_t>(ret.distance, children[i].distance + 1) : std::max<uint16_t>(ret.distance, children[i].distance + 1);
+                    }
+                }
+            } else if (ret.dn == 0) {
+                // The attacker's moves are all refuted and the disproof rests on every repetition they do, the defender
+                // picks the refutation resting on the fewest. One that only repeats positions from here down holds
+                // whatever the path, since the attacker could only have forced a win by never repeating a position
+                PositionKey position = ctx.path.back();
+                const ProofNumbers* chosen = nullptr;
+                ret.dependency = UINT16_MAX;
+                for (uint8_t i = 0; i < successors.size; i++) {
+                    const ProofNumbers& child = children[i];
+                    if (child.dn != 0) {
+                        continue;
+                    } else if (attacking) {
+                        ret.dependency = std::min(ret.dependency, child.dependency);
+                        ret.rest_on(child, position);
+                    } else if (!chosen || child.rests_on_less(*chosen)) {
+                        chosen = &child;
+                    }
+                }
+                if (chosen) {
+                    ret.dependency = chosen->dependency;
+                    ret.rest_on(*chosen, position);
+                }
+                if (ret.dependency >= ctx.path.size() - 1) {
+                    ret.dependency = UINT16_MAX;
+                    ret.repeated_count = 0;
+                }
+            }
+
+            // A disproof resting on repetitions above this position is kept for paths through the same positions, while
+            // they fit the entry
+            if (ret.dn != 0 || ret.dependency == UINT16_MAX) {
+                worker.table.store(ProofTable::make_key<RulesT>(state, to_move, worker.attacker), ret, ctx.stats.nodes - start);
+            } else if (ret.repeated_count <= ProofNumbers::max_repeated && RulesT::state_count * 2 <= 0x1000) {
+                worker.table.store_dependent(ProofTable::make_key<RulesT>(state, to_move, worker.attacker), ret, ctx.path.back(), ctx.stats.nodes - start);
+            }
+            return ret;
+        }
+
+        // Iterative deepening from starting_depth until max_depth has been searched, the root result is proven or stop_flag
+        // is set, on_depth is called with the result of every completed depth
+        template <typename CallbackT>
+        void deepen(unsigned int starting_depth, unsigned int max_depth, const std::atomic<bool>& stop_flag, CallbackT on_depth, PlayerID player_id = PLAYER_NONE, SearchBuffers* buffers = nullptr) {
+            if (player_id == PLAYER_NONE) {
+                player_id = this->player_id;
+            }
+
+            StateIndex root = RulesT::pack_state(game_state);
+            const Successors& successors = successors_of(root, player_id);
+            if (successors.size == 0) {
+                return;
+            }
+
+            SearchBuffers local_buffers;
+            if (!buffers) {
+                buffers = &local_buffers;
+            }
+
+            std::vector<RootMove>& root_moves = buffers->root_moves;
+            root_moves.assign(successors.size, RootMove());
+            for (uint8_t i = 0; i < successors.size; i++) {
+                root_moves[i].move = successors.moves[i];
+                root_moves[i].state = successors.children[i];
+                root_moves[i].context = i;
+            }
+
+            // Lazy SMP helpers stop whenever the main search finishes a depth
+            std::atomic<bool> helpers_stop(false);
+            std::vector<SearchContext>& contexts = buffers->contexts;
+            size_t context_count = std::max<size_t>(successors.size, search_pool().size());
+            contexts.erase(contexts.begin() + std::min(contexts.size(), context_count), contexts.end());
+            for (size_t i = 0; i < context_count; i++) {
+                const std::atomic<bool>& context_stop = search_mode == SearchMode::LazySMP && i != 0 ? helpers_stop : stop_flag;
+                if (i < contexts.size()) {
+                    contexts[i].reset(context_stop, player_id);
+                } else {
+                    contexts.emplace_back(context_stop, player_id);
+                }
+                contexts[i].push(position_key(root, player_id));
+            }
+
+            // Lazy SMP only shares work through a transposition table
+            BasicGame searcher = *this;
+            if (search_mode == SearchMode::LazySMP && !tt) {
+                if (buffers->tt) {
+                    buffers->tt->clear();
+                } else {
+                    buffers->tt.reset(new TranspositionTable);
+                }
+                searcher.tt = buffers->tt.get();
+            }
+            if (search_mode == SearchMode::MCTS) {
+                buffers->tree.reset(mcts.max_nodes, root, successors.children, successors.size);
+            } else if (search_mode == SearchMode::ProofNumber) {
+                if (!buffers->proofs || buffers->proofs->capacity() != ProofTable::capacity_for(proof.table_size)) {
+                    buffers->proofs.reset(new ProofTable(proof.table_size));
+                } else {
+                    buffers->proofs->clear();
+                }
+                for (unsigned int phase = 0; phase < 2; phase++) {
+                    buffers->proof_root[phase] = ProofNumbers();
+                    buffers->proof_children[phase].assign(successors.size, ProofNumbers());
+                }
+            }
+
+            SearchStats totals;
+            std::vector<std::atomic<uint64_t>> worker_nodes(search_pool().size() + 1);
+
+            tp::TaskGroup group(search_pool());
+            auto collect = [&totals, &contexts, &worker_nodes, &group]() {
+                SearchCounters& counters = totals;
+                counters = SearchCounters();
+                for (const auto& ctx : contexts) {
+                    counters += ctx.stats;
+                }
+                totals.worker_nodes.assign(worker_nodes.begin(), worker_nodes.end());
+                totals.queue_wait = group.queue_wait();
+            };
+
+            for (unsigned int depth = starting_depth; depth <= max_depth && depth < max_ply && !stop_flag; depth++) {
+                auto start = std::chrono::steady_clock::now();
+                uint64_t start_nodes = totals.nodes;
+                size_t best_move;
+                bool settled = false; // Solved by a proof-number search, which need not have found the quickest result
+                if (search_mode == SearchMode::MCTS) {
+                    best_move = searcher.search_tree(buffers->tree, root_moves, contexts, depth, group, worker_nodes);
+                } else if (search_mode == SearchMode::ProofNumber) {
+                    best_move = searcher.search_proof(*buffers, contexts, depth, group, worker_nodes, settled);
+                } else {
+                    best_move = searcher.search_root(root_moves, contexts, depth, stop_flag, helpers_stop, group, worker_nodes);
+                }
+                // Monte Carlo and proof-number searches stopped partway through a depth still know more than the last
+                // depth did
+                if (!stop_flag || search_mode == SearchMode::MCTS || search_mode == SearchMode::ProofNumber) {
+                    collect();
+                    totals.depths.push_back({depth, std::chrono::steady_clock::now() - start, totals.nodes - start_nodes});
+
+                    int score = root_moves[best_move].score;
+                    BestMove ret(root_moves[best_move].move, depth);
+                    ret.score = score;
+                    if (settled || (is_decided(score) && score_distance(score) <= depth)) {
+                        // Every shorter win would already have been found, and a loss means every move loses. A result
+                        // further away than this depth came from the table and may have a shorter alternative
+                        ret.depth = is_decided(score) ? score_distance(score) : 0;
+                        ret.solved = true;
+                        ret.outcome = score > 0 ? OUTCOME_WIN : (score < 0 ? OUTCOME_LOSS : OUTCOME_DRAW);
+                    }
+
+                    // With several exact moves the best multi_pv of them all have to be proven before deeper searches
+                    // stop changing their scores
+                    bool proven = ret.solved;
+                    if (multi_pv > 1) {
+                        boost::container::static_vector<int, max_moves> scores;
+                        for (const RootMove& root_move : root_moves) {
+                            if (root_move.exact) {
+                                scores.push_back(root_move.score);
+                            }
+                        }
+                        std::sort(scores.begin(), scores.end(), std::greater<int>());
+                        for (size_t i = 0; i < scores.size() && i < multi_pv; i++) {
+                            proven = proven && is_decided(scores[i]) && score_distance(scores[i]) <= depth;
+                        }
+                    }
+
+                    on_depth(ret);
+                    if (progress) {
+                        progress(ret, totals);
+                    }
+                    if (proven || (node_budget && totals.nodes >= node_budget)) {
+                        break;
+                    }
+
+                    // The next depth tries the moves in order of this depth's scores
+                    std::swap(root_moves[0], root_moves[best_move]);
+                    std::stable_sort(root_moves.begin() + 1, root_moves.end(), [](const RootMove& a, const RootMove& b) {
+                        return a.score > b.score;
+                    });
+                }
+            }
+
+            if (stats) {
+                collect();
+                *stats = std::move(totals);
+            }
+        }
+
+        bool probe_tablebase(BestMove& ret, PlayerID player_id = PLAYER_NONE) {
+            if (player_id == PLAYER_NONE) {
+                player_id = this->player_id;
+            }
+
+            if ((tablebase || solution) && evaluate(player_id) == 0) {
+                typename Tablebase::Entry entry = tablebase ? tablebase->probe(game_state, player_id) : solution->probe(game_state, player_id);
+                ret = BestMove(entry.best_move, entry.distance);
+                ret.solved = true;
+                ret.outcome = entry.outcome;
+                ret.score = entry.outcome * (score_win - (int) entry.distance);
+                return true;
+            }
+            return false;
+        }
+
+        // Searches for at most search_time, but always completes at least one depth
+        template <typename DurationT>
+        BestMove find_best_move(DurationT search_time, unsigned int starting_depth = 10, PlayerID player_id = PLAYER_NONE);
+
+        // The move player_id is expected to play from the current state, taken from the transposition table or the
+        // tablebase when they know one and from a shallow search otherwise. Returns false when player_id has no moves
+        bool expected_move(Move& ret, PlayerID player_id = PLAYER_NONE, unsigned int depth = 8) {
+            if (player_id == PLAYER_NONE) {
+                player_id = this->player_id;
+            }
+
+            if (tt) {
+                TranspositionTable::Entry entry;
+                if (tt->probe(TranspositionTable::make_key<RulesT>(game_state, player_id), entry, player_id) && entry.has_best_move) {
+                    ret = entry.best_move;
+                    return true;
+                }
+            }
+
+            BestMove best_move;
+            if (!probe_tablebase(best_move, player_id)) {
+                best_move = find_best_move_to_depth(depth, player_id);
+            }
+            ret = best_move;
+            return best_move.from_player != PLAYER_NONE;
+        }
+
+        // Searches every depth up to and including depth without a time limit
+        BestMove find_best_move_to_depth(unsigned int depth, PlayerID player_id = PLAYER_NONE) {
+            BestMove ret;
+            if (probe_tablebase(ret, player_id)) {
+                return ret;
+            }
+
+            std::atomic<bool> stop(false);
+            deepen(
+                1, depth, stop, [&ret](const BestMove& best_move) {
+                    ret = best_move;
+                },
+                player_id);
+            return ret;
+        }
+
+        // The moves the transposition table expects from state with to_move to play, at most length of them. Stops at
+        // moves it has no entry for and at repeated positions
+        std::vector<Move> principal_variation(StateIndex state, PlayerID to_move, unsigned int length) {
+            std::vector<Move> ret;
+            if (!tt) {
+                return ret;
+            }
+
+            bool seen[state_count * 2] = {};
+            while (ret.size() < length && evaluate(state, to_move) == 0 && !seen[position_key(state, to_move)]) {
+                seen[position_key(state, to_move)] = true;
+
+                TranspositionTable::Entry entry;
+                if (!tt->probe(TranspositionTable::make_key<RulesT>(state, to_move), entry, to_move) || !entry.has_best_move) {
+                    break;
+                }
+                const Successors& successors = move_table.successors[state][to_move];
+                const Move* end = successors.moves + successors.size;
+                const Move* move = std::find(successors.moves, end, entry.best_move);
+                if (move == end) {
+                    break;
+                }
+
+                ret.push_back(*move);
+                state = successors.children[move - successors.moves];
+                to_move = opposite_player(to_move);
+            }
+            return ret;
+        }
+
+        // Searches every depth up to and including depth once and returns every root move best first, the first count
+        // of them with exact scores. Each move comes with its expected continuation
+        std::vector<RankedMove> rank_moves(unsigned int depth, size_t count = SIZE_MAX, PlayerID player_id = PLAYER_NONE) {
+            if (player_id == PLAYER_NONE) {
+                player_id = this->player_id;
+            }
+
+            // Continuations are read back from the table, so the search needs one
+            TranspositionTable local_tt;
+            BasicGame searcher = *this;
+            searcher.multi_pv = count;
+            if (!searcher.tt) {
+                searcher.tt = &local_tt;
+            }
+
+            SearchBuffers buffers;
+            std::atomic<bool> stop(false);
+            unsigned int completed = 0;
+            searcher.deepen(
+                1, depth, stop, [&completed](const BestMove&) {
+                    completed++;
+                },
+                player_id, &buffers);
+
+            std::vector<RankedMove> ret;
+            if (completed == 0) {
+                return ret;
+            }
+            for (const RootMove& root_move : buffers.root_moves) {
+                RankedMove ranked {root_move.move, root_move.score, root_move.exact, completed, {root_move.move}};
+                std::vector<Move> continuation = searcher.principal_variation(root_move.state, opposite_player(player_id), completed - 1);
+                ranked.pv.insert(ranked.pv.end(), continuation.begin(), continuation.end());
+                ret.push_back(std::move(ranked));
+            }
+            std::stable_sort(ret.begin(), ret.end(), [](const RankedMove& a, const RankedMove& b) {
+                return a.score > b.score;
+            });
+            return ret;
+        }
+    };
+
+    typedef BasicGame<> Game;
+
+    // Reads "attack L R" or "split L R N" from fields as a move of the player to move in game, false if it is not a
+    // legal one
+    template <typename RulesT>
+    bool parse_move(std::istream& fields, BasicGame<RulesT>& game, Move& ret) {
+        std::string kind, from_hand, to_hand;
+        fields >> kind >> from_hand >> to_hand;
+        ret = Move();
+        ret.from_player = game.player_id;
+        ret.to_player = kind == "split" ? ret.from_player : opposite_player(ret.from_player);
+        if (kind == "split") {
+            unsigned short amount = 0;
+            fields >> amount;
+            ret.amount = amount;
+        }
+
+        std::vector<Move> possible_moves;
+        game.find_all_moves(std::back_inserter(possible_moves));
+        return (kind == "attack" || kind == "split") && parse_hand(from_hand, ret.from_hand) && parse_hand(to_hand, ret.to_hand) &&
+               std::find(possible_moves.begin(), possible_moves.end(), ret) != possible_moves.end();
+    }
+
+    // Writes move the way parse_move reads it, "none" for a move without a player
+    inline std::string move_string(const Move& move) {
+        if (move.from_player == PLAYER_NONE) {
+            return "none";
+        }
+
+        std::string ret = move.from_player == move.to_player ? "split " : "attack ";
+        ret += move.from_hand == HAND_L ? 'l' : 'r';
+        ret += ' ';
+        ret += move.to_hand == HAND_L ? 'l' : 'r';
+        if (move.from_player == move.to_player) {
+            ret += ' ' + std::to_string(move.amount);
+        }
+        return ret;
+    }
+
+    // A search run by the search controller, shared between the controller and whoever waits on it
+    class SearchJob {
+    public:
+        std::atomic<bool> stop_flag {false};
+
+        // Copies the best move of the deepest completed depth, returns false if no depth has completed yet
+        bool poll(BestMove& ret) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            ret = result;
+            return updates != 0;
+        }
+
+        // Number of depths completed so far
+        size_t update_count() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return updates;
+        }
+
+        // True once the search has reached its maximum depth, proven the result, been stopped or found no moves
+        bool done() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return finished;
+        }
+
+        // Waits until the search is done or timeout has passed, returns done()
+        template <typename DurationT>
+        bool wait_for(DurationT timeout) {
+            std::unique_lock<std::mutex> lock(mutex);
+            return condition.wait_for(lock, timeout, [this]() { return finished; });
+        }
+
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return finished; });
+        }
+
+        // Waits until at least one depth has completed or the search is done
+        void wait_for_result() {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return finished || updates != 0; });
+        }
+
+        // Stops the search without waiting for it, at once if a depth has completed and otherwise as soon as the
+        // first one does, so it always has a move to report
+        void request_stop() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (updates) {
+                stop_flag = true;
+            } else {
+                stop_requested = true;
+            }
+        }
+
+    protected:
+        friend class SearchController;
+
+        std::function<void(SearchJob&)> search; // Runs the search on a driver thread, publishing every completed depth
+        std::chrono::steady_clock::time_point deadline; // Stops the search once a depth has completed past it
+        std::function<void(const BestMove&)> on_update;
+        std::function<void()> on_finish; // Called once the job is done, from whichever thread finished it
+
+        mutable std::mutex mutex;
+        std::condition_variable condition;
+        BestMove result;
+        size_t updates = 0;
+        bool finished = false;
+        bool stop_requested = false;
+
+        SearchJob(std::chrono::steady_clock::time_point deadline, std::function<void(const BestMove&)> on_update, std::function<void()> on_finish) :
+            deadline(deadline),
+            on_update(std::move(on_update)),
+            on_finish(std::move(on_finish)) { }
+
+        void publish(const BestMove& best_move) {
+            bool stop;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                result = best_move;
+                updates++;
+                stop = stop_requested;
+            }
+            condition.notify_all();
+
+            if (stop || deadline <= std::chrono::steady_clock::now()) {
+                stop_flag = true;
+            }
+            if (on_update) {
+                on_update(best_move);
+            }
+        }
+
+        void finish() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished = true;
+            }
+            condition.notify_all();
+
+            if (on_finish) {
+                on_finish();
+            }
+        }
+    };
+
+    // Long-lived threads that run every search started through SearchHandle or find_best_move, so starting a search
+    // costs a queue push instead of a thread spawn. A driver thread is added only when all existing ones are busy and
+    // each keeps search buffers for every rule variant it has searched, until it has been idle for idle_timeout and
+    // exits with them. Deadlines are enforced by one timer thread that raises the stop flag of searches that have run
+    // out of time, so callers only ever wait on their job
+    class SearchController {
+    public:
+        SearchController() = default;
+        SearchController(const SearchController&) = delete;
+        SearchController& operator=(const SearchController&) = delete;
+
+        ~SearchController() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                quit = true;
+                for (auto& job : active) {
+                    job->stop_flag = true;
+                }
+            }
+            work_condition.notify_all();
+            timer_condition.notify_all();
+
+            for (auto& driver : drivers) {
+                driver.join();
+            }
+            for (auto& driver : retired) {
+                driver.join();
+            }
+            if (timer.joinable()) {
+                timer.join();
+            }
+        }
+
+        // Queues a search of a copy of game for player_id, positions in the tablebase are answered immediately
+        template <typename RulesT>
+        std::shared_ptr<SearchJob> submit(const BasicGame<RulesT>& game, PlayerID player_id = PLAYER_NONE, unsigned int starting_depth = 1, unsigned int max_depth = UINT_MAX,
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max(), std::function<void(const BestMove&)> on_update = nullptr, std::function<void()> on_finish = nullptr) {
+            if (player_id == PLAYER_NONE) {
+                player_id = game.player_id;
+            }
+            std::shared_ptr<SearchJob> job(new SearchJob(deadline, std::move(on_update), std::move(on_finish)));
+
+            BestMove solved;
+            BasicGame<RulesT> copy = game;
+            if (copy.probe_tablebase(solved, player_id)) {
+                job->publish(solved);
+                job->finish();
+                return job;
+            }
+
+            job->search = [game = std::move(copy), player_id, starting_depth, max_depth](SearchJob& job) mutable {
+                static thread_local BasicSearchBuffers<RulesT> buffers;
+                game.deepen(
+                    starting_depth, max_depth, job.stop_flag, [&job](const BestMove& best_move) {
+                        job.publish(best_move);
+                    },
+                    player_id, &buffers);
+            };
+
+            std::vector<std::thread> exited;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                active.push_back(job);
+                queue.push_back(job);
+                if (queue.size() > idle_drivers) {
+                    drivers.emplace_back(&SearchController::drive, this);
+                }
+                if (deadline != std::chrono::steady_clock::time_point::max() && !timer.joinable()) {
+                    timer = std::thread(&SearchController::time, this);
+                }
+                exited.swap(retired);
+            }
+            work_condition.notify_one();
+            timer_condition.notify_one();
+            for (auto& driver : exited) {
+                driver.join();
+            }
+            return job;
+        }
+
+        // Driver threads running, busy or idle
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return drivers.size();
+        }
+
+    protected:
+        mutable std::mutex mutex;
+        std::condition_variable work_condition;
+        std::condition_variable timer_condition;
+        std::deque<std::shared_ptr<SearchJob>> queue;
+        std::vector<std::shared_ptr<SearchJob>> active; // Queued or running
+        std::vector<std::thread> drivers;
+        std::vector<std::thread> retired; // Drivers that timed out, joined by the next submit
+        std::thread timer;
+        size_t idle_drivers = 0;
+        bool quit = false;
+
+        static constexpr std::chrono::seconds idle_timeout {30};
+
+        void drive() {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                idle_drivers++;
+                bool woken = work_condition.wait_for(lock, idle_timeout, [this]() { return quit || !queue.empty(); });
+                idle_drivers--;
+                if (!woken) {
+                    // The thread's search buffers are freed as it exits
+                    auto self = std::find_if(drivers.begin(), drivers.end(), [](const std::thread& driver) {
+                        return driver.get_id() == std::this_thread::get_id();
+                    });
+                    retired.push_back(std::move(*self));
+                    drivers.erase(self);
+                    return;
+                } else if (queue.empty()) {
+                    return;
+                }
+
+                std::shared_ptr<SearchJob> job = std::move(queue.front());
+                queue.pop_front();
+                lock.unlock();
+
+                job->search(*job);
+
+                lock.lock();
+                active.erase(std::find(active.begin(), active.end(), job));
+                lock.unlock();
+                job->finish();
+                job.reset();
+                lock.lock();
+            }
+        }
+
+        void time() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!quit) {
+                // Jobs past their deadline are stopped if they have a result, the others stop themselves when their
+                // first depth completes
+                auto now = std::chrono::steady_clock::now();
+                auto next = std::chrono::steady_clock::time_point::max();
+                for (auto& job : active) {
+                    if (job->stop_flag) {
+                        continue;
+                    } else if (job->deadline <= now) {
+                        if (job->update_count()) {
+                            job->stop_flag = true;
+                        }
+                    } else {
+                        next = std::min(next, job->deadline);
+                    }
+                }
+
+                if (next == std::chrono::steady_clock::time_point::max()) {
+                    timer_condition.wait(lock);
+                } else {
+                    timer_condition.wait_until(lock, next);
+                }
+            }
+        }
+    };
+
+    namespace detail {
+        inline SearchController controller; // NOLINT
+    } // namespace detail
+
+    // Handle to one search at a time running on the search controller, so the caller can keep working while it runs
+    class SearchHandle {
+    public:
+        std::function<void(const BestMove&)> on_update; // Called from the search thread after every completed depth
+
+        SearchHandle() = default;
+        SearchHandle(const SearchHandle&) = delete;
+        SearchHandle& operator=(const SearchHandle&) = delete;
+
+        ~SearchHandle() {
+            stop();
+        }
+
+        // Starts searching a copy of game for player_id, stopping any search already running. Positions in the
+        // tablebase are answered immediately
+        template <typename RulesT>
+        void start(const BasicGame<RulesT>& game, PlayerID player_id = PLAYER_NONE, unsigned int starting_depth = 1, unsigned int max_depth = UINT_MAX,
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max()) {
+            stop();
+            job = detail::controller.submit(game, player_id, starting_depth, max_depth, deadline, on_update);
+        }
+
+        // Asks the search to stop and waits for it, the last completed depth stays available to poll
+        void stop() {
+            if (job) {
+                job->stop_flag = true;
+                job->wait();
+            }
+        }
+
+        bool poll(BestMove& ret) const {
+            if (!job) {
+                ret = BestMove();
+                return false;
+            }
+            return job->poll(ret);
+        }
+
+        size_t update_count() const {
+            return job ? job->update_count() : 0;
+        }
+
+        bool done() const {
+            return !job || job->done();
+        }
+
+        template <typename DurationT>
+        bool wait_for(DurationT timeout) {
+            return !job || job->wait_for(timeout);
+        }
+
+        void wait() {
+            if (job) {
+                job->wait();
+            }
+        }
+
+        void wait_for_result() {
+            if (job) {
+                job->wait_for_result();
+            }
+        }
+
+    protected:
+        std::shared_ptr<SearchJob> job;
+    };
+
+    template <typename RulesT>
+    template <typename DurationT>
+    BestMove BasicGame<RulesT>::find_best_move(DurationT search_time, unsigned int starting_depth, PlayerID player_id) {
+        // The controller stops the search at the deadline, or after the first depth if that takes longer
+        SearchHandle search;
+        search.start(*this, player_id, starting_depth, UINT_MAX, std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(search_time));
+        search.wait();
+
+        BestMove ret;
+        search.poll(ret);
+        return ret;
+    }
+
+    template <typename RulesT>
+    void BasicTablebase<RulesT>::solve() {
+        typedef BasicSuccessors<RulesT> Successors;
+        constexpr unsigned int state_count = RulesT::state_count;
+        const BasicMoveTable<RulesT>& move_table = rules_move_table<RulesT>;
+
+        // Retrograde analysis over every (state, player to move) pair
+        std::vector<std::vector<unsigned int>> predecessors(state_count * 2);
+        std::vector<uint8_t> remaining(state_count * 2, 0);
+        std::vector<bool> resolved(state_count * 2, false);
+        std::vector<unsigned int> queue;
+        queue.reserve(state_count * 2);
+
+        for (unsigned int i = 0; i < state_count * 2; i++) {
+            PlayerID to_move = (PlayerID) (i % 2);
+            int evaluation = RulesT::evaluate(i / 2, to_move);
+            if (evaluation != 0) {
+                entries[i].outcome = (Outcome) evaluation;
+                resolved[i] = true;
+                queue.push_back(i);
+                continue;
+            }
+
+            const Successors& successors = move_table.successors[i / 2][to_move];
+            remaining[i] = successors.size;
+            for (uint8_t j = 0; j < successors.size; j++) {
+                predecessors[successors.children[j] * 2 + opposite_player(to_move)].push_back(i);
+            }
+        }
+
+        // Positions leave the queue in order of distance, so the first losing successor found is the quickest win
+        // and the last winning successor resolved is the slowest loss
+        for (size_t i = 0; i < queue.size(); i++) {
+            const Entry& entry = entries[queue[i]];
+            for (unsigned int predecessor : predecessors[queue[i]]) {
+                if (resolved[predecessor]) {
+                    continue;
+                }
+
+                if (entry.outcome == OUTCOME_LOSS) {
+                    entries[predecessor].outcome = OUTCOME_WIN;
+                } else if (--remaining[predecessor] == 0) {
+                    entries[predecessor].outcome = OUTCOME_LOSS;
+                } else {
+                    continue;
+                }
+                entries[predecessor].distance = entry.distance + 1;
+                resolved[predecessor] = true;
+                queue.push_back(predecessor);
+            }
+        }
+
+        // Pick the move that realizes each label
+        for (unsigned int i = 0; i < state_count * 2; i++) {
+            PlayerID to_move = (PlayerID) (i % 2);
+            const Successors& successors = move_table.successors[i / 2][to_move];
+
+            Entry& entry = entries[i];
+            for (uint8_t j = 0; j < successors.size; j++) {
+                const Entry& child = probe(successors.children[j], opposite_player(to_move));
+                if (child.outcome == -entry.outcome && (entry.outcome == OUTCOME_DRAW || child.distance + 1 == entry.distance)) {
+                    entry.best_move = successors.moves[j];
+                    break;
+                }
+            }
+        }
+    }
+
+    // A position to analyse with its own budget
+    struct AnalysisJob {
+        size_t id = 0; // Returned with the result, since results arrive in completion order
+        Player players[2] = {{1, 1}, {1, 1}};
+        PlayerID to_move = PLAYER_A;
+        unsigned int depth = 0; // Deepest iteration to search, 0 searches until max_ply
+        uint64_t nodes = 0;     // Node budget, 0 disables
+    };
+
+    struct AnalysisResult {
+        size_t id;
+        BestMove best_move; // Left at depth 0 without a from_player when the side to move has no moves
+        uint64_t nodes;
+    };
+
+    // Analyses every job next produces until it returns false. As many driver threads as the pool has workers each
+    // read the next job as soon as their last one is done and search it on the pool, so a slow job holds up no others
+    // and an unbounded stream only ever holds that many. next and emit are called from the drivers, one call of each
+    // at a time, emit in the order jobs finish. The jobs themselves are never pool tasks, so a search waiting for its
+    // tasks only ever helps with those of other searches and never starts another job inside its own. Each job gets a
+    // fresh transposition table unless a shared one is given, sharing is much faster over many positions but makes
+    // results depend on what was searched before. Runs on the default pool unless given another. The first exception
+    // next, a job or emit throws stops every driver from reading more and is rethrown once the others are done
+    template <typename NextT, typename EmitT>
+    void analyze(NextT next, EmitT emit, const Tablebase* tablebase = nullptr, TranspositionTable* shared_tt = nullptr, tp::ThreadPool* pool = nullptr) {
+        tp::ThreadPool& analysis_pool = pool ? *pool : default_pool();
+        std::mutex next_mutex;
+        std::mutex emit_mutex;
+        std::atomic<bool> failed(false);
+        std::exception_ptr error;
+
+        auto drive = [&]() {
+            try {
+                for (;;) {
+                    AnalysisJob job;
+                    {
+                        std::lock_guard<std::mutex> lock(next_mutex);
+                        if (failed || !next(job)) {
+                            return;
+                        }
+                    }
+
+                    std::unique_ptr<TranspositionTable> local_tt(shared_tt ? nullptr : new TranspositionTable(state_count * 4));
+                    SearchStats stats;
+                    Game game(job.to_move);
+                    game.game_state[PLAYER_A] = job.players[PLAYER_A];
+                    game.game_state[PLAYER_B] = job.players[PLAYER_B];
+                    game.tablebase = tablebase;
+                    game.tt = shared_tt ? shared_tt : local_tt.get();
+                    game.stats = &stats;
+                    game.node_budget = job.nodes;
+                    game.pool = &analysis_pool;
+
+                    AnalysisResult result {job.id, game.find_best_move_to_depth(job.depth ? job.depth : max_ply), 0};
+                    result.nodes = stats.nodes;
+
+                    std::lock_guard<std::mutex> lock(emit_mutex);
+                    if (failed) {
+                        return;
+                    }
+                    emit(result);
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(next_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                failed = true;
+            }
+        };
+
+        // The calling thread is one of the drivers
+        std::vector<std::thread> drivers;
+        try {
+            for (unsigned int i = 1; i < std::max(analysis_pool.size(), 1u); i++) {
+                drivers.emplace_back(drive);
+            }
+        } catch (...) {
+            failed = true;
+            for (auto& driver : drivers) {
+                driver.join();
+            }
+            throw;
+        }
+        drive();
+        for (auto& driver : drivers) {
+            driver.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
 } // namespace stix
\ No newline at end of file
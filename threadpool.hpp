@@ -1,20 +1,36 @@
 #ifndef _THREADPOOL_HPP
 #define _THREADPOOL_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <exception>
+#include <fstream>
 #include <functional>
 #include <memory>
+#include <new>
 #include <mutex>
-#include <queue>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 namespace tp {
     enum class CommandType {
         Quit,
-        Execute
+        Execute,
+        Group
     };
 
     enum class CommandStatus {
@@ -24,11 +40,6 @@ namespace tp {
     };
 
     class Command {
-    private:
-        friend class ThreadPool;
-        std::mutex mutex;
-        std::condition_variable condition;
-
     public:
         CommandType type;
         CommandStatus status = CommandStatus::Running;
@@ -39,17 +50,14 @@ namespace tp {
         Command(CommandType type, void* data = nullptr) :
             type(type),
             data(data) { }
-
-        CommandStatus await() {
-            std::unique_lock<std::mutex> lock(mutex);
-            while (status == CommandStatus::Running) {
-                condition.wait(lock);
-            }
-            return status;
-        }
     };
 
     class CommandExecute: public Command {
+    private:
+        friend class ThreadPool;
+        std::mutex mutex;
+        std::condition_variable condition;
+
     public:
         std::function<void(void*)> func;
         std::exception error;
@@ -61,134 +69,804 @@ namespace tp {
             type = CommandType::Execute;
             this->data = data;
         }
+
+        CommandStatus await() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (status == CommandStatus::Running) {
+                condition.wait(lock);
+            }
+            return status;
+        }
     };
 
     using Task = CommandExecute;
 
+    class TaskGroup;
+
+    namespace detail {
+        template <typename R>
+        struct ClosureResult {
+            std::optional<R> value;
+        };
+
+        template <>
+        struct ClosureResult<void> { };
+
+        template <typename F, typename R>
+        struct Closure: public ClosureResult<R> {
+            F func;
+
+            Closure(F func) :
+                func(std::move(func)) { }
+
+            void call() {
+                if constexpr (std::is_void<R>::value) {
+                    func();
+                } else {
+                    this->value.emplace(func());
+                }
+            }
+        };
+    } // namespace detail
+
+    // Task owned by a TaskGroup, its callable lives in an inline buffer that the group recycles, and completion is
+    // signalled through the group's countdown instead of a mutex and condition variable
+    class GroupCommand: public Command {
+    protected:
+        friend class ThreadPool;
+        friend class TaskGroup;
+        template <typename T>
+        friend class Future;
+
+        static constexpr size_t storage_size = 128;
+
+        alignas(std::max_align_t) unsigned char storage[storage_size];
+        void* closure = nullptr; // Points into storage, or to the heap for oversized callables
+        void* result = nullptr;
+        void (*invoke)(void*) = nullptr;
+        void (*destroy)(void*) = nullptr;
+        TaskGroup* group = nullptr;
+        std::chrono::steady_clock::time_point enqueued;
+        std::exception_ptr error; // Thrown by the callable, for its future
+        std::atomic<bool> done {false};
+
+        void run();
+
+    public:
+        GroupCommand() :
+            Command(CommandType::Group) { }
+
+        inline bool ready() const {
+            return done.load(std::memory_order_acquire);
+        }
+    };
+
+    // CPUs a worker may run on
+    typedef std::vector<unsigned int> CpuSet;
+
+    namespace detail {
+        // Parses a kernel CPU list such as "0-3,8,10-11"
+        inline CpuSet parse_cpu_list(const std::string& list) {
+            CpuSet ret;
+            size_t begin = 0;
+            while (begin < list.size()) {
+                size_t end = list.find(',', begin);
+                std::string range = list.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+                size_t dash = range.find('-');
+                try {
+                    unsigned int first = std::stoul(range.substr(0, dash));
+                    unsigned int last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+                    for (unsigned int cpu = first; cpu <= last; cpu++) {
+                        ret.push_back(cpu);
+                    }
+                } catch (const std::exception&) { }
+                begin = end == std::string::npos ? list.size() : end + 1;
+            }
+            return ret;
+        }
+
+        // CPUs the process may run on
+        inline CpuSet allowed_cpus() {
+            CpuSet ret;
+#ifdef __linux__
+            cpu_set_t set;
+            if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+                for (unsigned int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                    if (CPU_ISSET(cpu, &set)) {
+                        ret.push_back(cpu);
+                    }
+                }
+            }
+#endif
+            return ret;
+        }
+    } // namespace detail
+
+    // Every CPU the process may run on as a set of its own, so each worker is pinned to one CPU
+    inline std::vector<CpuSet> cpu_affinity() {
+        std::vector<CpuSet> ret;
+        for (unsigned int cpu : detail::allowed_cpus()) {
+            ret.push_back({cpu});
+        }
+        return ret;
+    }
+
+    // The CPUs of each NUMA node the process may run on, so workers are spread across nodes and move freely within
+    // one. Machines that do not report their nodes count as a single node
+    inline std::vector<CpuSet> numa_affinity() {
+        CpuSet allowed = detail::allowed_cpus();
+        std::vector<CpuSet> ret;
+
+        std::ifstream online("/sys/devices/system/node/online");
+        std::string nodes;
+        if (online && std::getline(online, nodes)) {
+            for (unsigned int node : detail::parse_cpu_list(nodes)) {
+                std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+                std::string cpus;
+                if (!file || !std::getline(file, cpus)) {
+                    continue;
+                }
+
+                CpuSet set;
+                for (unsigned int cpu : detail::parse_cpu_list(cpus)) {
+                    if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) {
+                        set.push_back(cpu);
+                    }
+                }
+                if (!set.empty()) {
+                    ret.push_back(std::move(set));
+                }
+            }
+        }
+
+        if (ret.empty() && !allowed.empty()) {
+            ret.push_back(std::move(allowed));
+        }
+        return ret;
+    }
+
+    enum class SchedulingPolicy {
+        RoundRobin,  // Each task is bound to the queue it was scheduled on
+        WorkStealing // Workers keep their own deque and steal from others when it runs dry
+    };
+
     class ThreadPool {
     protected:
-        struct CommandQueue {
-            std::queue<std::shared_ptr<Command>> queue;
+        // Ring buffer deque, the owner takes from the back and thieves take from the front
+        class CommandQueue {
+        protected:
+            std::vector<std::shared_ptr<Command>> buffer;
+            size_t head = 0;
+            size_t count = 0;
+
+        public:
             std::mutex mutex;
             std::condition_variable condition;
+            std::atomic<bool> retired {false}; // Set with mutex held once the queue's worker is leaving, nothing is pushed after
+
+            CommandQueue() :
+                buffer(64) { }
+
+            inline bool empty() const {
+                return count == 0;
+            }
+
+            void push_back(std::shared_ptr<Command> command) {
+                if (count == buffer.size()) {
+                    std::vector<std::shared_ptr<Command>> new_buffer(buffer.size() * 2);
+                    for (size_t i = 0; i < count; i++) {
+                        new_buffer[i] = std::move(buffer[(head + i) % buffer.size()]);
+                    }
+                    buffer = std::move(new_buffer);
+                    head = 0;
+                }
+                buffer[(head + count++) % buffer.size()] = std::move(command);
+            }
+
+            inline const std::shared_ptr<Command>& front() const {
+                return buffer[head];
+            }
+
+            std::shared_ptr<Command> pop_front() {
+                std::shared_ptr<Command> ret = std::move(buffer[head]);
+                head = (head + 1) % buffer.size();
+                count--;
+                return ret;
+            }
+
+            std::shared_ptr<Command> pop_back() {
+                return std::move(buffer[(head + --count) % buffer.size()]);
+            }
+        };
+
+        struct WorkerContext {
+            ThreadPool* pool = nullptr;
+            unsigned int index = 0;
         };
 
-        void runner(CommandQueue* commands) {
+        static WorkerContext& this_worker() {
+            thread_local WorkerContext worker;
+            return worker;
+        }
+
+        static bool execute(const std::shared_ptr<Command>& command) {
+            switch (command->type) {
+                default: {
+                    throw std::runtime_error("Invalid command type");
+                }
+
+                case CommandType::Execute: {
+                    auto cmd = (CommandExecute*) command.get();
+                    try {
+                        cmd->func(cmd->arg);
+
+                        std::unique_lock<std::mutex> lock(cmd->mutex);
+                        cmd->status = CommandStatus::Success;
+                    } catch (const std::exception& e) {
+                        std::unique_lock<std::mutex> lock(cmd->mutex);
+                        cmd->status = CommandStatus::Failure;
+                        cmd->error = e;
+                    }
+
+                    cmd->condition.notify_all();
+                    return true;
+                }
+
+                case CommandType::Group: {
+                    ((GroupCommand*) command.get())->run();
+                    return true;
+                }
+
+                case CommandType::Quit: {
+                    return false;
+                }
+            }
+        }
+
+        void runner(CommandQueue* commands, unsigned int index) {
+            this_worker() = {this, index};
+
             for (;;) {
                 std::unique_lock<std::mutex> lock(commands->mutex);
-                while (commands->queue.empty()) {
+                while (commands->empty()) {
                     commands->condition.wait(lock);
                 }
-                std::shared_ptr<Command> command = std::move(commands->queue.front());
-                commands->queue.pop();
+                std::shared_ptr<Command> command = commands->pop_front();
                 lock.unlock();
 
-                switch (command->type) {
-                    default: {
-                        throw std::runtime_error("Invalid command type");
-                    }
+                if (!execute(command)) {
+                    return;
+                }
+            }
+        }
 
-                    case CommandType::Execute: {
-                        auto cmd = (CommandExecute*) command.get();
-                        try {
-                            cmd->func(cmd->arg);
-
-                            std::unique_lock<std::mutex> lock(cmd->mutex);
-                            cmd->status = CommandStatus::Success;
-                        } catch (const std::exception& e) {
-                            std::unique_lock<std::mutex> lock(cmd->mutex);
-                            cmd->status = CommandStatus::Failure;
-                            cmd->error = e;
-                        }
+        std::shared_ptr<Command> take(unsigned int index, bool owner = true) {
+            if (owner) {
+                std::unique_lock<std::mutex> lock(queues[index].mutex);
+                if (!queues[index].empty()) {
+                    pending.fetch_sub(1);
+                    return queues[index].pop_back();
+                }
+            }
 
-                        cmd->condition.notify_all();
+            unsigned int count = live.load();
+            for (size_t i = !owner ? 0 : 1; i < count; i++) {
+                CommandQueue& victim = queues[(index + i) % count];
+
+                std::unique_lock<std::mutex> lock(victim.mutex);
+                if (!victim.empty()) {
+                    pending.fetch_sub(1);
+                    return victim.pop_front();
+                }
+            }
+            return nullptr;
+        }
+
+        // A worker whose queue was retired leaves once the queue is empty, nothing can be pushed to it any more
+        bool leaving(unsigned int index) {
+            if (!queues[index].retired.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            std::unique_lock<std::mutex> lock(queues[index].mutex);
+            return queues[index].empty();
+        }
+
+        void stealing_runner(unsigned int index) {
+            this_worker() = {this, index};
+
+            for (;;) {
+                if (leaving(index)) {
+                    return;
+                }
+
+                std::shared_ptr<Command> command;
+                for (unsigned int spins = 0; spins < 64; spins++) {
+                    if ((command = take(index))) {
                         break;
                     }
+                    std::this_thread::yield();
+                }
 
-                    case CommandType::Quit: {
-                        return;
-                    }
+                if (command) {
+                    execute(command);
+                    continue;
+                }
+
+                // Park only once there is nothing left to take anywhere
+                std::unique_lock<std::mutex> lock(idle_mutex);
+                idle_workers.fetch_add(1);
+                while (pending == 0 && !quit && !queues[index].retired) {
+                    idle_condition.wait(lock);
+                }
+                idle_workers.fetch_sub(1);
+
+                if (quit && pending == 0) {
+                    return;
                 }
             }
         }
 
-        std::vector<std::pair<std::thread, CommandQueue*>> threads;
-        unsigned int sched_counter = 0;
-
-    public:
-        ThreadPool(unsigned int pool_size = std::thread::hardware_concurrency()) {
-            for (unsigned int i = 0; i < pool_size; i++) {
-                auto new_queue = new CommandQueue;
-                std::thread new_thread(&ThreadPool::runner, this, new_queue);
-                threads.push_back({std::move(new_thread), new_queue});
+        void pin(std::thread& thread, unsigned int index) {
+#ifdef __linux__
+            CpuSet cpus = affinity.empty() ? detail::allowed_cpus() : affinity[index % affinity.size()];
+            if (cpus.empty()) {
+                return;
             }
-        };
 
-        ~ThreadPool() {
-            for (auto& thread : threads) {
-                auto cmd = std::make_shared<Command>(CommandType::Quit);
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (unsigned int cpu : cpus) {
+                if (cpu < CPU_SETSIZE) {
+                    CPU_SET(cpu, &set);
+                }
+            }
+            pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+            (void) thread;
+            (void) index;
+#endif
+        }
 
+        void shutdown() {
+            if (policy == SchedulingPolicy::WorkStealing) {
                 {
-                    std::unique_lock<std::mutex> lock(thread.second->mutex);
-                    thread.second->queue.push(std::move(cmd));
+                    std::unique_lock<std::mutex> lock(idle_mutex);
+                    quit = true;
+                }
+                idle_condition.notify_all();
+            } else {
+                for (unsigned int i = 0; i < threads.size(); i++) {
+                    {
+                        std::unique_lock<std::mutex> lock(queues[i].mutex);
+                        queues[i].push_back(std::make_shared<Command>(CommandType::Quit));
+                    }
+                    queues[i].condition.notify_one();
                 }
-                thread.second->condition.notify_one();
             }
 
             for (auto& thread : threads) {
-                thread.first.join();
-                delete thread.second;
+                thread.join();
             }
-        };
+            threads.clear();
+        }
 
-        std::shared_ptr<Task> schedule(std::function<void(void*)> func, void* arg = nullptr, void* data = nullptr) {
-            CommandQueue* commands = threads[sched_counter].second;
-            auto cmd = std::make_shared<CommandExecute>(std::move(func), arg, data);
+        // Queues are allocated once for the largest size the pool may grow to, so workers and schedulers can index
+        // them while the pool is resized
+        std::unique_ptr<CommandQueue[]> queues;
+        unsigned int capacity;
+        std::atomic<unsigned int> active {0}; // Workers taking newly scheduled tasks
+        std::atomic<unsigned int> live {0};   // Queues that may hold tasks, including those of workers still leaving
+        std::vector<std::thread> threads;
+        std::vector<CpuSet> affinity;
+        std::mutex resize_mutex;
+        std::atomic<unsigned int> sched_counter {0};
+        SchedulingPolicy policy;
+
+        // Work stealing state
+        std::atomic<size_t> pending {0};
+        std::atomic<unsigned int> idle_workers {0};
+        bool quit = false;
+        std::mutex idle_mutex;
+        std::condition_variable idle_condition;
+
+        friend class TaskGroup;
+
+        void enqueue(std::shared_ptr<Command> cmd) {
+            CommandQueue* commands;
+            for (;;) {
+                if (policy == SchedulingPolicy::WorkStealing && this_worker().pool == this && !queues[this_worker().index].retired) {
+                    commands = &queues[this_worker().index];
+                } else {
+                    commands = &queues[sched_counter++ % active.load()];
+                }
 
-            {
+                // A resize may have retired the queue since it was picked
                 std::unique_lock<std::mutex> lock(commands->mutex);
-                commands->queue.push(cmd);
+                if (commands->retired) {
+                    continue;
+                }
+                if (policy == SchedulingPolicy::WorkStealing) {
+                    pending.fetch_add(1);
+                }
+                commands->push_back(std::move(cmd));
+                break;
             }
 
-            commands->condition.notify_one();
-            sched_counter = (sched_counter + 1) % threads.size();
+            if (policy == SchedulingPolicy::WorkStealing) {
+                if (idle_workers) {
+                    std::unique_lock<std::mutex> lock(idle_mutex);
+                    idle_condition.notify_one();
+                }
+            } else {
+                commands->condition.notify_one();
+            }
+        }
+
+    public:
+        // Workers are pinned to the CPU sets of affinity in turn, an empty affinity lets them run anywhere. The pool
+        // can be resized up to max_pool_size workers, or to the larger of pool_size and the hardware concurrency when
+        // that is 0
+        ThreadPool(unsigned int pool_size = std::thread::hardware_concurrency(), SchedulingPolicy policy = SchedulingPolicy::RoundRobin, std::vector<CpuSet> affinity = {}, unsigned int max_pool_size = 0) :
+            affinity(std::move(affinity)),
+            policy(policy) {
+            pool_size = std::max(pool_size, 1u);
+            capacity = max_pool_size ? std::max(max_pool_size, pool_size) : std::max(pool_size, std::thread::hardware_concurrency());
+            queues.reset(new CommandQueue[capacity]);
+            resize(pool_size);
+        };
+
+        ~ThreadPool() {
+            shutdown();
+        };
 
+        std::shared_ptr<Task> schedule(std::function<void(void*)> func, void* arg = nullptr, void* data = nullptr) {
+            auto cmd = std::make_shared<CommandExecute>(std::move(func), arg, data);
+            enqueue(cmd);
             return cmd;
         };
 
-        void resize(unsigned int new_pool_size) {
-            if (new_pool_size == threads.size()) {
-                return;
+        // Runs one queued task on the calling thread, returns false if there was nothing to run
+        bool run_pending() {
+            std::shared_ptr<Command> command;
+            if (policy == SchedulingPolicy::WorkStealing) {
+                if (this_worker().pool == this) {
+                    command = take(this_worker().index);
+                } else {
+                    command = take(sched_counter % live.load(), false);
+                }
+            } else {
+                for (unsigned int i = 0; i < live.load(); i++) {
+                    std::unique_lock<std::mutex> lock(queues[i].mutex);
+                    if (!queues[i].empty() && queues[i].front()->type != CommandType::Quit) {
+                        command = queues[i].pop_front();
+                        break;
+                    }
+                }
+            }
+
+            if (command) {
+                execute(command);
+                return true;
             }
+            return false;
+        }
 
-            if (new_pool_size < threads.size()) {
-                for (unsigned int i = 0; i < new_pool_size; i++, sched_counter = (sched_counter + 1) % threads.size()) {
-                    auto cmd = std::make_shared<Command>(CommandType::Quit);
+        // Changes the number of workers while the pool is in use. Tasks already queued for a leaving worker still run,
+        // on that worker or, under work stealing, on whichever worker takes them first. Shrinking waits for the leaving
+        // workers to finish, so it must not be called from one of them
+        void resize(unsigned int new_pool_size) {
+            std::lock_guard<std::mutex> lock(resize_mutex);
+            new_pool_size = std::max(new_pool_size, 1u);
+            if (new_pool_size > capacity) {
+                throw std::invalid_argument("Thread pool size exceeds its capacity");
+            }
 
+            unsigned int old_pool_size = threads.size();
+            if (new_pool_size > old_pool_size) {
+                for (unsigned int i = old_pool_size; i < new_pool_size; i++) {
                     {
-                        std::unique_lock<std::mutex> lock(threads[sched_counter].second->mutex);
-                        threads[sched_counter].second->queue.push(std::move(cmd));
+                        std::unique_lock<std::mutex> queue_lock(queues[i].mutex);
+                        queues[i].retired = false;
+                    }
+                    if (policy == SchedulingPolicy::WorkStealing) {
+                        threads.emplace_back(&ThreadPool::stealing_runner, this, i);
+                    } else {
+                        threads.emplace_back(&ThreadPool::runner, this, &queues[i], i);
                     }
-                    threads[sched_counter].second->condition.notify_one();
+                    pin(threads.back(), i);
+                }
+                live = new_pool_size;
+                active = new_pool_size;
+            } else if (new_pool_size < old_pool_size) {
+                active = new_pool_size;
+                for (unsigned int i = new_pool_size; i < old_pool_size; i++) {
+                    {
+                        std::unique_lock<std::mutex> queue_lock(queues[i].mutex);
+                        queues[i].retired = true;
+                        if (policy == SchedulingPolicy::RoundRobin) {
+                            queues[i].push_back(std::make_shared<Command>(CommandType::Quit)); // Behind its remaining tasks
+                        }
+                    }
+                    queues[i].condition.notify_one();
+                }
+                if (policy == SchedulingPolicy::WorkStealing) {
+                    std::unique_lock<std::mutex> idle_lock(idle_mutex);
+                    idle_condition.notify_all();
+                }
 
-                    threads[sched_counter].first.join();
-                    delete threads[sched_counter].second;
+                for (unsigned int i = new_pool_size; i < old_pool_size; i++) {
+                    threads[i].join();
                 }
+                threads.erase(threads.begin() + new_pool_size, threads.end());
+                live = new_pool_size;
+            }
+        }
 
-                threads.resize(new_pool_size);
-            } else {
-                for (unsigned int i = threads.size(); i < new_pool_size; i++) {
-                    auto new_queue = new CommandQueue;
-                    std::thread new_thread(&ThreadPool::runner, this, new_queue);
-                    threads.push_back({std::move(new_thread), new_queue});
+        // Pins every worker, current and future, to the CPU sets of affinity in turn. An empty affinity lets them run
+        // on any CPU the process may use
+        void set_affinity(std::vector<CpuSet> affinity) {
+            std::lock_guard<std::mutex> lock(resize_mutex);
+            this->affinity = std::move(affinity);
+            for (unsigned int i = 0; i < threads.size(); i++) {
+                pin(threads[i], i);
+            }
+        }
+
+        inline unsigned int size() const {
+            return active.load();
+        }
+
+        inline unsigned int max_size() const {
+            return capacity;
+        }
+
+        inline SchedulingPolicy scheduling_policy() const {
+            return policy;
+        }
+
+        // Index of the calling thread among this pool's workers, -1 for any other thread
+        inline int worker_index() const {
+            return this_worker().pool == this ? (int) this_worker().index : -1;
+        }
+    };
+
+    template <typename T>
+    class Future {
+    protected:
+        friend class TaskGroup;
+        GroupCommand* command = nullptr;
+
+        Future(GroupCommand* command) :
+            command(command) { }
+
+    public:
+        Future() = default;
+
+        inline bool ready() const {
+            return command->ready();
+        }
+
+        // Runs other pending tasks until this one is done, and once there have been none for a while sleeps until it is
+        void wait() const;
+
+        // Valid until the group is reused after being joined. Rethrows what the task threw, which the group's wait
+        // reports as well
+        template <typename U = T>
+        typename std::enable_if<!std::is_void<U>::value, U&>::type get() const {
+            wait();
+            if (command->error) {
+                std::rethrow_exception(command->error);
+            }
+            return *((detail::ClosureResult<T>*) command->result)->value;
+        }
+    };
+
+    // Fork/join scope over a ThreadPool, tasks are stored in slots the group owns and reuses, and joining runs queued
+    // work on the waiting thread, only blocking it once there has been none for a while
+    class TaskGroup {
+    protected:
+        friend class GroupCommand;
+        template <typename T>
+        friend class Future;
+
+        static constexpr size_t inline_commands = 8;
+        static constexpr size_t chunk_size = 32;
+        static constexpr unsigned int wait_spins = 1024; // Yields of a wait or join with nothing to run before it sleeps
+
+        ThreadPool& pool;
+        std::atomic<size_t> pending {0};
+        std::atomic<int64_t> wait_time {0}; // Nanoseconds tasks spent queued
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        // Futures and joins sleeping, woken by every task that finishes while there are any
+        std::atomic<unsigned int> sleepers {0};
+        std::mutex done_mutex;
+        std::condition_variable done_condition;
+
+        GroupCommand commands[inline_commands];
+        std::vector<std::unique_ptr<GroupCommand[]>> chunks;
+        size_t used = 0;
+        bool joined = false;
+
+        GroupCommand* allocate() {
+            if (joined) {
+                recycle();
+            }
+
+            if (used < inline_commands) {
+                return &commands[used++];
+            }
+
+            size_t i = used++ - inline_commands;
+            if (i / chunk_size >= chunks.size()) {
+                chunks.emplace_back(new GroupCommand[chunk_size]);
+            }
+            return &chunks[i / chunk_size][i % chunk_size];
+        }
+
+        inline GroupCommand* at(size_t i) {
+            return i < inline_commands ? &commands[i] : &chunks[(i - inline_commands) / chunk_size][(i - inline_commands) % chunk_size];
+        }
+
+        void recycle() {
+            for (size_t i = 0; i < used; i++) {
+                GroupCommand* command = at(i);
+                command->destroy(command->closure);
+                command->status = CommandStatus::Running;
+                command->error = nullptr;
+                command->done.store(false, std::memory_order_relaxed);
+            }
+            used = 0;
+            joined = false;
+        }
+
+        void fail(std::exception_ptr e) {
+            std::unique_lock<std::mutex> lock(error_mutex);
+            if (!error) {
+                error = e;
+            }
+        }
+
+        void join() {
+            unsigned int spins = 0;
+            while (pending.load(std::memory_order_acquire)) {
+                if (pool.run_pending()) {
+                    spins = 0;
+                } else if (spins < wait_spins) {
+                    spins++;
+                    std::this_thread::yield();
+                } else {
+                    // Wakes now and then to run tasks queued meanwhile, which the group's tasks may need
+                    sleepers.fetch_add(1, std::memory_order_seq_cst);
+                    {
+                        std::unique_lock<std::mutex> lock(done_mutex);
+                        done_condition.wait_for(lock, std::chrono::milliseconds(1), [this]() {
+                            return pending.load(std::memory_order_acquire) == 0;
+                        });
+                    }
+                    sleepers.fetch_sub(1, std::memory_order_relaxed);
                 }
             }
+            // The last task may still be releasing done_mutex after it dropped the count to zero
+            std::lock_guard<std::mutex> lock(done_mutex);
+            joined = true;
+        }
+
+    public:
+        TaskGroup(ThreadPool& pool) :
+            pool(pool) { }
+
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        ~TaskGroup() {
+            join();
+            recycle();
+        }
+
+        template <typename F>
+        Future<typename std::invoke_result<F&>::type> run(F func) {
+            typedef typename std::invoke_result<F&>::type R;
+            typedef detail::Closure<F, R> ClosureT;
+
+            GroupCommand* command = allocate();
+            if constexpr (sizeof(ClosureT) <= GroupCommand::storage_size && alignof(ClosureT) <= alignof(std::max_align_t)) {
+                command->closure = new (command->storage) ClosureT(std::move(func));
+                command->destroy = [](void* closure) {
+                    ((ClosureT*) closure)->~ClosureT();
+                };
+            } else {
+                command->closure = new ClosureT(std::move(func));
+                command->destroy = [](void* closure) {
+                    delete (ClosureT*) closure;
+                };
+            }
+            command->result = static_cast<detail::ClosureResult<R>*>((ClosureT*) command->closure);
+            command->invoke = [](void* closure) {
+                ((ClosureT*) closure)->call();
+            };
+            command->group = this;
+
+            pending.fetch_add(1, std::memory_order_relaxed);
+            command->enqueued = std::chrono::steady_clock::now();
+            // The group owns the command, so the queue gets a non-owning pointer and no control block is allocated
+            pool.enqueue(std::shared_ptr<Command>(std::shared_ptr<Command>(), command));
+            return Future<R>(command);
         }
 
-        inline decltype(threads)::size_type size() const {
-            return threads.size();
+        // Rethrows the first exception thrown by a task
+        void wait() {
+            join();
+            if (error) {
+                std::exception_ptr e = std::move(error);
+                error = nullptr;
+                std::rethrow_exception(e);
+            }
+        }
+
+        inline size_t size() const {
+            return used;
+        }
+
+        inline size_t pool_size() const {
+            return pool.size();
+        }
+
+        // Total time tasks of this group waited in the pool's queues before a thread started them
+        inline std::chrono::nanoseconds queue_wait() const {
+            return std::chrono::nanoseconds(wait_time.load(std::memory_order_relaxed));
         }
     };
+
+    inline void GroupCommand::run() {
+        group->wait_time.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - enqueued).count(), std::memory_order_relaxed);
+
+        try {
+            invoke(closure);
+            status = CommandStatus::Success;
+        } catch (...) {
+            status = CommandStatus::Failure;
+            error = std::current_exception();
+            group->fail(error);
+        }
+
+        // Pairs with the sleeper count a waiting future or join raises before it checks done or pending. The count only
+        // drops under the lock when someone sleeps, so a join that sees it reach zero waits for the lock before the
+        // group can go away
+        done.store(true, std::memory_order_seq_cst);
+        if (group->sleepers.load(std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> lock(group->done_mutex);
+            group->done_condition.notify_all();
+            group->pending.fetch_sub(1, std::memory_order_release);
+        } else {
+            group->pending.fetch_sub(1, std::memory_order_release); // The group may be gone after this
+        }
+    }
+
+    template <typename T>
+    void Future<T>::wait() const {
+        TaskGroup* group = command->group;
+        unsigned int spins = 0;
+        while (!command->ready()) {
+            if (group->pool.run_pending()) {
+                spins = 0;
+            } else if (spins < TaskGroup::wait_spins) {
+                spins++;
+                std::this_thread::yield();
+            } else {
+                // Wakes now and then to run tasks queued meanwhile, which the task waited on may need
+                group->sleepers.fetch_add(1, std::memory_order_seq_cst);
+                {
+                    std::unique_lock<std::mutex> lock(group->done_mutex);
+                    group->done_condition.wait_for(lock, std::chrono::milliseconds(1), [this]() {
+                        return command->done.load(std::memory_order_seq_cst);
+                    });
+                }
+                group->sleepers.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+    }
 } // namespace tp
 
 #endif
\ No newline at end of file
@@ -0,0 +1,258 @@
+#include "stix.hpp"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One side of the match, given on the command line as a comma separated list such as "depth=12,time=50,mode=lazy-smp"
+struct Engine {
+    std::string name;
+    unsigned int depth = UINT_MAX; // Deepest iteration, combined with time whichever comes first
+    unsigned int time = 0;         // Milliseconds per move, 0 for no limit
+    stix::SearchMode mode = stix::SearchMode::RootSplit;
+    bool use_tablebase = false;
+    bool use_tt = true;
+    bool symmetry_reduction = false;
+    unsigned int threads = 0; // Per search, 0 for the whole pool
+    stix::MCTSSettings mcts;
+
+    // Totals over every move this engine made
+    std::atomic<uint64_t> moves {0};
+    std::atomic<uint64_t> nodes {0};
+    std::atomic<uint64_t> depths {0};
+    std::atomic<uint64_t> nanoseconds {0};
+};
+
+struct Options {
+    unsigned int games = 100;
+    unsigned int concurrency = std::max(std::thread::hardware_concurrency(), 1u);
+    unsigned int threads = 0; // Size of the search thread pool, 0 for the hardware concurrency
+    unsigned int opening_plies = 4;
+    unsigned int max_plies = 200;
+    uint64_t seed = 1;
+};
+
+enum Result {
+    RESULT_WIN,
+    RESULT_DRAW,
+    RESULT_LOSS
+};
+
+bool parse_engine(const std::string& spec, Engine& ret) {
+    std::istringstream fields(spec);
+    std::string field;
+    while (std::getline(fields, field, ',')) {
+        size_t equals = field.find('=');
+        if (equals == std::string::npos) {
+            return false;
+        }
+        std::string key = field.substr(0, equals);
+        std::string value = field.substr(equals + 1);
+        if (key == "name") {
+            ret.name = value;
+        } else if (key == "depth") {
+            ret.depth = std::stoul(value);
+        } else if (key == "time") {
+            ret.time = std::stoul(value);
+        } else if (key == "mode" && value == "root-split") {
+            ret.mode = stix::SearchMode::RootSplit;
+        } else if (key == "mode" && value == "lazy-smp") {
+            ret.mode = stix::SearchMode::LazySMP;
+        } else if (key == "mode" && value == "mcts") {
+            ret.mode = stix::SearchMode::MCTS;
+        } else if (key == "mode" && value == "proof-number") {
+            ret.mode = stix::SearchMode::ProofNumber;
+        } else if (key == "playouts" && value == "random") {
+            ret.mcts.playout_policy = stix::PlayoutPolicy::Random;
+        } else if (key == "playouts" && value == "decisive") {
+            ret.mcts.playout_policy = stix::PlayoutPolicy::Decisive;
+        } else if (key == "playouts" && value == "anti-decisive") {
+            ret.mcts.playout_policy = stix::PlayoutPolicy::AntiDecisive;
+        } else if (key == "exploration") {
+            ret.mcts.exploration = std::stod(value);
+        } else if (key == "tablebase") {
+            ret.use_tablebase = value != "0";
+        } else if (key == "tt") {
+            ret.use_tt = value != "0";
+        } else if (key == "symmetry") {
+            ret.symmetry_reduction = value != "0";
+        } else if (key == "threads") {
+            ret.threads = std::stoul(value);
+        } else {
+            return false;
+        }
+    }
+    if (ret.depth == UINT_MAX && ret.time == 0) {
+        ret.depth = 12;
+    }
+    return true;
+}
+
+// Plays one game from opening with white moving first, the result is from white's perspective. Positions seen three
+// times and games longer than max_plies are draws
+Result play(Engine& white, Engine& black, const stix::Game& opening, const Options& options, tp::ThreadPool& pool) {
+    stix::TranspositionTable tables[2];
+    Engine* engines[2] = {&white, &black};
+    stix::Game game = opening;
+
+    std::map<std::pair<stix::StateIndex, stix::PlayerID>, unsigned int> seen;
+    for (unsigned int ply = 0; ply < options.max_plies; ply++) {
+        stix::PlayerID player_id = game.player_id;
+        if (game.evaluate(player_id) != 0) {
+            bool white_won = (game.evaluate(player_id) > 0) == (player_id == opening.player_id);
+            return white_won ? RESULT_WIN : RESULT_LOSS;
+        } else if (++seen[{stix::pack_state(game.game_state), player_id}] >= 3) {
+            return RESULT_DRAW;
+        }
+
+        Engine& engine = *engines[player_id != opening.player_id];
+        stix::TranspositionTable& tt = tables[player_id != opening.player_id];
+        stix::SearchStats stats;
+        game.tt = engine.use_tt ? &tt : nullptr;
+        game.tablebase = engine.use_tablebase ? &stix::Tablebase::standard() : nullptr;
+        game.search_mode = engine.mode;
+        game.symmetry_reduction = engine.symmetry_reduction;
+        game.thread_budget = engine.threads;
+        game.mcts = engine.mcts;
+        game.pool = &pool;
+        game.stats = &stats;
+
+        auto start = std::chrono::steady_clock::now();
+        stix::SearchHandle search;
+        auto deadline = engine.time ? start + std::chrono::milliseconds(engine.time) : std::chrono::steady_clock::time_point::max();
+        search.start(game, player_id, 1, engine.depth, deadline);
+        search.wait();
+
+        stix::BestMove best_move;
+        if (!search.poll(best_move)) {
+            return RESULT_DRAW; // No moves left
+        }
+        engine.moves++;
+        engine.nodes += stats.nodes;
+        engine.depths += best_move.depth;
+        engine.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+        game.move(best_move);
+        game.player_id = (stix::PlayerID) !player_id;
+    }
+    return RESULT_DRAW;
+}
+
+// Plays opening_plies uniformly random moves from the starting position, stopping early if the game is decided
+stix::Game random_opening(std::mt19937_64& rng, unsigned int opening_plies) {
+    stix::Game ret(stix::PLAYER_A);
+    for (unsigned int ply = 0; ply < opening_plies && ret.evaluate() == 0; ply++) {
+        std::vector<stix::Move> moves;
+        ret.find_all_moves(std::back_inserter(moves));
+        if (moves.empty()) {
+            break;
+        }
+        ret.move(moves[std::uniform_int_distribution<size_t>(0, moves.size() - 1)(rng)]);
+        ret.player_id = (stix::PlayerID) !ret.player_id;
+    }
+    return ret;
+}
+
+double elo(double score) {
+    score = std::min(std::max(score, 1e-6), 1. - 1e-6);
+    return -400. * std::log10(1. / score - 1.);
+}
+
+void print_engine(const Engine& engine) {
+    uint64_t moves = std::max<uint64_t>(engine.moves, 1);
+    std::cout << std::left << std::setw(12) << engine.name << " moves " << engine.moves << " nodes/move " << (double) engine.nodes / moves
+              << " depth/move " << (double) engine.depths / moves << " ms/move " << engine.nanoseconds / 1e6 / moves << std::endl;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    Engine engines[2];
+    engines[0].name = "engine1";
+    engines[1].name = "engine2";
+    unsigned int engine_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--engine" && i + 1 < argc && engine_count < 2) {
+            if (!parse_engine(argv[++i], engines[engine_count++])) {
+                std::cerr << "Invalid engine: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--games" && i + 1 < argc) {
+            options.games = std::stoul(argv[++i]);
+        } else if (arg == "--concurrency" && i + 1 < argc) {
+            options.concurrency = std::max(std::stoul(argv[++i]), 1ul);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = std::stoul(argv[++i]);
+        } else if (arg == "--opening-plies" && i + 1 < argc) {
+            options.opening_plies = std::stoul(argv[++i]);
+        } else if (arg == "--max-plies" && i + 1 < argc) {
+            options.max_plies = std::stoul(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            options.seed = std::stoull(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " --engine SPEC --engine SPEC [--games N] [--concurrency N] [--threads N]"
+                      << " [--opening-plies N] [--max-plies N] [--seed N]" << std::endl;
+            std::cerr << "SPEC is a comma separated list of name=NAME, depth=N, time=MS, mode=root-split|lazy-smp|mcts|proof-number, tablebase=0|1, tt=0|1, symmetry=0|1, threads=N,"
+                      << " playouts=random|decisive|anti-decisive, exploration=C" << std::endl;
+            return 1;
+        }
+    }
+    tp::ThreadPool pool(options.threads ? options.threads : std::thread::hardware_concurrency(), tp::SchedulingPolicy::WorkStealing);
+
+    // Every opening is played twice with the engines swapping sides, so neither gets the better half of an opening
+    std::vector<stix::Game> openings;
+    std::mt19937_64 rng(options.seed);
+    for (unsigned int i = 0; i < (options.games + 1) / 2; i++) {
+        openings.push_back(random_opening(rng, options.opening_plies));
+    }
+
+    std::atomic<unsigned int> next_game(0);
+    uint64_t results[3] = {};
+    std::mutex results_mutex;
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> players;
+    for (unsigned int i = 0; i < std::min(options.concurrency, options.games); i++) {
+        players.emplace_back([&]() {
+            for (unsigned int game = next_game++; game < options.games; game = next_game++) {
+                bool swapped = game % 2;
+                Result result = play(engines[swapped], engines[!swapped], openings[game / 2], options, pool);
+                if (swapped && result != RESULT_DRAW) {
+                    result = result == RESULT_WIN ? RESULT_LOSS : RESULT_WIN;
+                }
+
+                std::lock_guard<std::mutex> lock(results_mutex);
+                results[result]++;
+            }
+        });
+    }
+    for (auto& player : players) {
+        player.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Score and its 95% confidence interval from the per game score variance
+    uint64_t games = results[RESULT_WIN] + results[RESULT_DRAW] + results[RESULT_LOSS];
+    double n = std::max<uint64_t>(games, 1);
+    double score = (results[RESULT_WIN] + 0.5 * results[RESULT_DRAW]) / n;
+    double variance = (results[RESULT_WIN] * std::pow(1. - score, 2) + results[RESULT_DRAW] * std::pow(0.5 - score, 2) + results[RESULT_LOSS] * std::pow(score, 2)) / n;
+    double margin = 1.96 * std::sqrt(variance / n);
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << engines[0].name << " vs " << engines[1].name << ": " << games << " games in " << seconds << " s" << std::endl;
+    std::cout << "W/D/L " << results[RESULT_WIN] << '/' << results[RESULT_DRAW] << '/' << results[RESULT_LOSS] << std::endl;
+    std::cout << "Score " << score << " +- " << margin << " (95%)" << std::endl;
+    std::cout << "Elo " << elo(score) << " [" << elo(score - margin) << ", " << elo(score + margin) << ']' << std::endl;
+    print_engine(engines[0]);
+    print_engine(engines[1]);
+    return 0;
+}